@@ -1,283 +1,2063 @@
 /*
  * a simple char device driver: globalfifo
+ * - Circular ring buffer, a single reader and a single writer run without sharing a lock.
  * - Block read until FIFO not empty.
  * - Block write until FIFO not full.
  * - Send async SIGIO signal after writing data to FIFO.
+ * - Signal attached eventfds when data becomes available or space frees up (FIFO_SET_EVENTFD).
+ * - Control page and data ring could be mapped by mmap() for zero-copy producer / consumer.
+ * - Ring capacity set by module parameter, or resized at runtime by ioctl / sysfs keeping buffered data.
+ * - Byte stream, or record mode preserving write boundaries (FIFO_SET_MODE).
+ * - Read low-watermark / write high-watermark, sleepers are woken only once enough data / space is there.
+ * - Broadcast mode, every reader has its own cursor and sees all data (block-slowest or overwrite-oldest).
+ * - Overwrite-oldest (lossy) mode, writers never block on readers, data dropped per reader is counted.
+ * - Per-CPU mode, writers append records to the ring of their CPU, readers drain all of them (optionally in order).
+ * - Priority lanes, urgent records are read before the FIFO ring (strict or weighted).
+ * - Writes are timestamped, log2 histogram of enqueue to dequeue latency, record times optionally read back.
+ * - splice() / sendfile() move data between FIFO and pipes / files without passing user space.
+ * - globalfifo_num independent FIFOs (/dev/globalfifo0 ...), one per minor, created via device class.
  */
 
 #include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/eventfd.h>
 #include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/percpu-rwsem.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/types.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
 
-#define GLOBALFIFO_SIZE 0x1000
-#define FIFO_CLEAR 0x1
+#include "globalfifo.h"
+
+#define GLOBALFIFO_SIZE 0x1000          // Default ring capacity.
+#define GLOBALFIFO_SIZE_MAX (64U << 20) // Upper limit of ring capacity.
 #define GLOBALFIFO_MAJOR 231
+#define GLOBALFIFO_NUM_MAX 1024         // Upper limit of FIFO instances (minors).
+#define GLOBALFIFO_STAMPS 1024          // Write times kept for FIFO ring, power of two.
+#define GLOBALFIFO_HIST_BUCKETS 40      // Latency histogram buckets [2^n, 2^(n+1)) ns, last one open ended.
+#define GLOBALFIFO_ARMED_IN 0           // poll_armed bit: FIFO seen not readable since last notification.
+#define GLOBALFIFO_ARMED_OUT 1          // poll_armed bit: FIFO seen not writable since last notification.
 
 static int globalfifo_major = GLOBALFIFO_MAJOR;
 module_param(globalfifo_major, int, S_IRUGO);
 
+// Initial ring capacity (bytes), rounded up to power of two.
+static unsigned int globalfifo_size = GLOBALFIFO_SIZE;
+module_param(globalfifo_size, uint, S_IRUGO);
+
+// Number of FIFO instances, each minor has its own ring, locks and wait queues.
+static unsigned int globalfifo_num = 1;
+module_param(globalfifo_num, uint, S_IRUGO);
+
+// Capacity of each priority lane (bytes), rounded up to power of two.
+static unsigned int globalfifo_lane_size = GLOBALFIFO_SIZE;
+module_param(globalfifo_lane_size, uint, S_IRUGO);
+
+/*
+Record ring in kernel memory only: ring of one CPU in per-CPU mode, or a priority lane.
+Ring of a CPU is replaced (empty) when per-CPU mode is set with another capacity.
+head is advanced by writers (lock held), tail by reader (read_mutex held).
+*/
+struct globalfifo_shard {
+    unsigned char *mem;
+    unsigned int size;
+    unsigned int head;
+    unsigned int tail;
+    struct mutex lock;       // Serialize writers of this ring (preempted, or migrated after picking the shard).
+    wait_queue_head_t wait;  // Writers waiting for space in this ring.
+};
+
+/*
+Record header in kernel rings, seq is only set in FIFO_MODE_ORDERED, stamp is write time (ktime ns).
+*/
+struct globalfifo_shard_hdr {
+    __u32 len;
+    __u32 pad;
+    __u64 seq;
+    __u64 stamp;
+};
+
+/*
+Priority lane, statistics are updated by reader (read_mutex held).
+*/
+struct globalfifo_lane {
+    struct globalfifo_shard ring;
+    unsigned int weight;      // Max reads in a row while lower lanes have data, 0 for strict priority.
+    unsigned int streak;      // Reads in a row served from this lane.
+    unsigned long records;    // Records read.
+    u64 latency_sum;          // Enqueue to dequeue latency (ns) of records read.
+    u64 latency_max;
+};
+
+/*
+Write time of FIFO ring data, kept beside the ring so that the mmap layout stays the same.
+*/
+struct globalfifo_stamp {
+    unsigned int end; // Ring head after the write.
+    u64 time;
+};
+
 struct globalfifo_dev {
     struct cdev cdev;
-    unsigned int current_len;
-    unsigned char mem[GLOBALFIFO_SIZE];
-    struct mutex mutex;                // Access protect to critical area FIFO and wait queue.
+    /*
+    Control page and data ring are allocated by vmalloc_user(), so both could be mapped to user space.
+    Control page lives as long as the device, data ring is replaced on resize.
+    Free running ring indices ctrl->head / ctrl->tail, used length = head - tail (wraps naturally as unsigned).
+    - head is only advanced by writer (write_mutex held), tail only by reader (read_mutex held),
+      or by the mmap producer / consumer in user space.
+    - Each side publishes its index by smp_store_release() after copying data, and reads the other
+      side's index by smp_load_acquire(), so a single reader and a single writer never share a lock.
+    - Indices in the shared page are untrusted, ring offsets are always masked and lengths clamped.
+    */
+    struct globalfifo_ctrl *ctrl;
+    unsigned char *mem;      // Circular ring buffer.
+    unsigned int size;       // Ring capacity, power of two, changed with read_mutex and write_mutex held.
+    unsigned int high_water; // Max bytes buffered seen by write path.
+    unsigned int mode;       // FIFO_MODE_xxx, changed on empty ring with read_mutex and write_mutex held.
+    unsigned int read_lowat;  // Readers are woken when at least read_lowat bytes are buffered.
+    unsigned int write_lowat; // Writers are woken when at least write_lowat bytes are free.
+    unsigned long read_wakeups_saved;  // Reader wakeups / SIGIO skipped below read_lowat (write_mutex held).
+    unsigned long write_wakeups_saved; // Writer wakeups skipped below write_lowat (read_mutex held).
+    atomic_t mmap_count;     // Number of VMAs mapping data ring, resize is refused while mapped.
+    struct mutex mmap_mutex; // Serialize mmap() of data ring against resize, lock order: write_mutex -> mmap_mutex.
+    struct mutex read_mutex;           // Serialize readers, protect tail.
+    struct mutex write_mutex;          // Serialize writers, protect head.
     wait_queue_head_t r_wait;          // Wait queue to wakeup blocking read process.
     wait_queue_head_t w_wait;          // Wait queue to wakeup blocking write process.
+    /*
+    poll() / epoll waiters, woken on readiness transitions only: a notification is sent if someone saw the
+    FIFO not ready (GLOBALFIFO_ARMED_xxx bit set) since the previous one, so idle or already ready FIFOs
+    cost no wakeups. Eventfds are signaled on the same transitions.
+    */
+    wait_queue_head_t poll_wait;
+    unsigned long poll_armed;
     struct fasync_struct *async_queue; // Async access I/O queue.
+    /*
+    Opened readers (read_mutex held). In broadcast mode every reader reads from its own cursor,
+    and tail is the slowest cursor (block-slowest) or the oldest data not overwritten yet.
+    */
+    struct list_head readers;
+    spinlock_t event_lock;          // Protect event_files.
+    struct list_head event_files;   // Files with eventfd attached.
+    /*
+    Per-CPU mode: shard writers hold mode_sem for read (cheap, no shared cache line) instead of write_mutex,
+    mode switch holds it for write. Lock order: mode_sem -> read_mutex -> write_mutex.
+    */
+    struct percpu_rw_semaphore mode_sem;
+    struct globalfifo_shard __percpu *shards;
+    unsigned int next_cpu;  // Shard drained next by reader (read_mutex held).
+    atomic64_t seq;         // Record numbering in FIFO_MODE_ORDERED.
+    // Priority lanes 1 .. FIFO_PRIO_MAX, lane writers hold mode_sem for read too.
+    struct globalfifo_lane lanes[FIFO_PRIO_MAX];
+    /*
+    Write times of FIFO ring, pushed by writer (write_mutex held) before head is published, dropped by reader
+    (read_mutex held) once tail passed their end. Writes are not timed while the table is full.
+    */
+    struct globalfifo_stamp *stamps;
+    unsigned int stamp_head;
+    unsigned int stamp_tail;
+    unsigned long latency_hist[GLOBALFIFO_HIST_BUCKETS]; // Enqueue to dequeue latency of reads (read_mutex held).
+    u64 dropped_bytes;   // Data dropped by overwrite-oldest writers (read_mutex held).
+    u64 dropped_records;
 };
 
-struct globalfifo_dev *globalfifo_devp;
+/*
+Per open file state.
+*/
+struct globalfifo_file {
+    struct globalfifo_dev *dev;
+    struct list_head node; // Entry of dev->readers once reading (read-only open or first read).
+    unsigned int cursor;   // Broadcast read position, behind tail if overwritten.
+    struct eventfd_ctx *eventfd;  // Attached by FIFO_SET_EVENTFD (event_lock held).
+    struct list_head event_node;  // Entry of dev->event_files if eventfd attached.
+    unsigned int prio;            // Priority lane of writes (FIFO_SET_PRIO), 0 for FIFO ring.
+    unsigned int write_flags;     // FIFO_WRITE_xxx (FIFO_SET_WRITE_FLAGS).
+    u64 dropped_bytes;            // Data overwritten before this reader read it (read_mutex held).
+    u64 dropped_records;
+};
+
+struct globalfifo_dev *globalfifo_devp; // Array of globalfifo_num devices.
+
+static struct class *globalfifo_class;
+
+/**
+ * Bytes in ring, could be called without lock (read / write side sees a stale but safe value).
+ */
+static unsigned int globalfifo_used(struct globalfifo_dev *dev)
+{
+    unsigned int used = smp_load_acquire(&dev->ctrl->head) - smp_load_acquire(&dev->ctrl->tail);
+
+    return min_t(unsigned int, used, READ_ONCE(dev->size));
+}
+
+static unsigned int globalfifo_free(struct globalfifo_dev *dev)
+{
+    return READ_ONCE(dev->size) - globalfifo_used(dev);
+}
+
+/**
+ * Ring space needed by a write of count bytes, record mode stores a length header in front.
+ */
+static unsigned long globalfifo_need(struct globalfifo_dev *dev, size_t count)
+{
+    unsigned int mode = READ_ONCE(dev->mode);
+
+    if (mode & FIFO_MODE_PERCPU)
+        return count + sizeof(struct globalfifo_shard_hdr);
+    if (mode & FIFO_MODE_RECORD)
+        return count + FIFO_RECORD_HDR_SIZE;
+    return 1;
+}
+
+/**
+ * Watermarks clamped to ring capacity, 0 behaves as 1 like SO_RCVLOWAT.
+ */
+static unsigned int globalfifo_read_lowat(struct globalfifo_dev *dev)
+{
+    return clamp(READ_ONCE(dev->read_lowat), 1U, READ_ONCE(dev->size));
+}
+
+static unsigned int globalfifo_write_lowat(struct globalfifo_dev *dev)
+{
+    return clamp(READ_ONCE(dev->write_lowat), 1U, READ_ONCE(dev->size));
+}
+
+static bool globalfifo_broadcast(struct globalfifo_dev *dev)
+{
+    return READ_ONCE(dev->mode) & FIFO_MODE_BROADCAST;
+}
+
+/**
+ * Writer drops oldest data instead of waiting for the slowest reader.
+ */
+static bool globalfifo_overwrite(struct globalfifo_dev *dev)
+{
+    return READ_ONCE(dev->mode) & FIFO_MODE_OVERWRITE;
+}
+
+static bool globalfifo_percpu(struct globalfifo_dev *dev)
+{
+    return READ_ONCE(dev->mode) & FIFO_MODE_PERCPU;
+}
+
+static unsigned int globalfifo_shard_free(struct globalfifo_shard *shard)
+{
+    return READ_ONCE(shard->size) - (READ_ONCE(shard->head) - smp_load_acquire(&shard->tail));
+}
+
+static bool globalfifo_shard_pending(struct globalfifo_shard *shard)
+{
+    return smp_load_acquire(&shard->head) != READ_ONCE(shard->tail);
+}
+
+/**
+ * Any CPU ring has records, could be called without lock.
+ */
+static bool globalfifo_shards_pending(struct globalfifo_dev *dev)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        if (globalfifo_shard_pending(per_cpu_ptr(dev->shards, cpu)))
+            return true;
+    }
+    return false;
+}
+
+static struct globalfifo_lane *globalfifo_lane(struct globalfifo_dev *dev, unsigned int prio)
+{
+    return &dev->lanes[prio - 1];
+}
+
+/**
+ * Any priority lane below prio (all lanes with FIFO_PRIO_NUM) has records.
+ */
+static bool globalfifo_lanes_pending(struct globalfifo_dev *dev, unsigned int prio)
+{
+    while (--prio > 0) {
+        if (globalfifo_shard_pending(&globalfifo_lane(dev, prio)->ring))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Read position of file, its own cursor in broadcast mode (moved up to tail if data was overwritten).
+ * A file not registered as reader yet would start from tail.
+ */
+static unsigned int globalfifo_read_pos(struct globalfifo_file *file)
+{
+    struct globalfifo_dev *dev = file->dev;
+    unsigned int tail = smp_load_acquire(&dev->ctrl->tail);
+
+    if (!globalfifo_broadcast(dev) || list_empty(&file->node) || (int)(file->cursor - tail) < 0)
+        return tail;
+    return file->cursor;
+}
+
+/**
+ * Register file as reader starting from the oldest buffered data, caller holds read_mutex.
+ */
+static void globalfifo_add_reader(struct globalfifo_file *file)
+{
+    struct globalfifo_dev *dev = file->dev;
+
+    file->cursor = dev->ctrl->tail;
+    list_add_tail(&file->node, &dev->readers);
+}
+
+static bool globalfifo_ready(struct globalfifo_file *file, bool reader, unsigned long need)
+{
+    struct globalfifo_dev *dev = file->dev;
+    unsigned int avail, prio;
+
+    // Urgent records are read first, a writer with priority writes to its lane.
+    if (reader && globalfifo_lanes_pending(dev, FIFO_PRIO_NUM))
+        return true;
+    prio = READ_ONCE(file->prio);
+    if (!reader && prio)
+        return globalfifo_shard_free(&globalfifo_lane(dev, prio)->ring) >= need;
+
+    // Per-CPU mode: any record to read, room in the ring of current CPU (poll() only, writer may migrate).
+    if (globalfifo_percpu(dev)) {
+        if (reader)
+            return globalfifo_shards_pending(dev);
+        return globalfifo_shard_free(per_cpu_ptr(dev->shards, raw_smp_processor_id())) >= need;
+    }
+
+    if (reader) {
+        avail = smp_load_acquire(&dev->ctrl->head) - globalfifo_read_pos(file);
+        return min_t(unsigned int, avail, READ_ONCE(dev->size)) >= need;
+    }
+    return globalfifo_free(dev) >= need;
+}
+
+/**
+ * Check if reader can read / writer can write need bytes (at least the watermark). If not ready, the caller is going to sleep:
+ * ask mmap peer for FIFO_NOTIFY by setting its waiting flag (kernel peer by poll_armed bit), then re-check ring.
+ * The full barrier pairs with the barrier between peer's index store and flag load, so either peer sees the
+ * flag or we see the new index.
+ */
+static bool globalfifo_check_ready(struct globalfifo_file *file, bool reader, unsigned long need)
+{
+    struct globalfifo_dev *dev = file->dev;
+
+    // Watermarks cover the FIFO ring only.
+    if (!globalfifo_percpu(dev) && (reader || !READ_ONCE(file->prio)))
+        need = max_t(unsigned long, need, reader ? globalfifo_read_lowat(dev) : globalfifo_write_lowat(dev));
+    if (globalfifo_ready(file, reader, need))
+        return true;
+    WRITE_ONCE(*(reader ? &dev->ctrl->reader_waiting : &dev->ctrl->writer_waiting), 1);
+    // Kernel side peers notify poll waiters and eventfds of the next transition, see globalfifo_notify().
+    if (!test_bit(reader ? GLOBALFIFO_ARMED_IN : GLOBALFIFO_ARMED_OUT, &dev->poll_armed))
+        set_bit(reader ? GLOBALFIFO_ARMED_IN : GLOBALFIFO_ARMED_OUT, &dev->poll_armed);
+    smp_mb();
+    return globalfifo_ready(file, reader, need);
+}
+
+/**
+ * Copy record header (or any small object) between ring (mem, size) and kernel buffer, handling wrap-around.
+ */
+static void globalfifo_ring_read(unsigned char *mem, unsigned int size, unsigned int idx, void *buf, size_t len)
+{
+    unsigned int off = idx & (size - 1);
+    size_t first = min_t(size_t, len, size - off);
+
+    memcpy(buf, mem + off, first);
+    memcpy(buf + first, mem, len - first);
+}
+
+static void globalfifo_ring_write(unsigned char *mem, unsigned int size, unsigned int idx, const void *buf,
+                                  size_t len)
+{
+    unsigned int off = idx & (size - 1);
+    size_t first = min_t(size_t, len, size - off);
+
+    memcpy(mem + off, buf, first);
+    memcpy(mem, buf + first, len - first);
+}
+
+/**
+ * Copy count bytes starting at ring index tail to user, in up to two segments when wrapping.
+ */
+static size_t globalfifo_copy_to_iter(unsigned char *mem, unsigned int size, unsigned int tail, size_t count,
+                                      struct iov_iter *to)
+{
+    unsigned int off = tail & (size - 1);
+    size_t first = min_t(size_t, count, size - off);
+    size_t copied = copy_to_iter(mem + off, first, to);
+
+    if (copied == first && count > first)
+        copied += copy_to_iter(mem, count - first, to);
+    return copied;
+}
+
+static size_t globalfifo_copy_from_iter(unsigned char *mem, unsigned int size, unsigned int head, size_t count,
+                                        struct iov_iter *from)
+{
+    unsigned int off = head & (size - 1);
+    size_t first = min_t(size_t, count, size - off);
+    size_t copied = copy_from_iter(mem + off, first, from);
+
+    if (copied == first && count > first)
+        copied += copy_from_iter(mem, count - first, from);
+    return copied;
+}
+
+/**
+ * Wake up sleepers only if any, avoid taking wait queue lock on the lock-free fast path.
+ * wq_has_sleeper() pairs with set_current_state() barrier of the sleeper.
+ * Blocked readers and byte stream writers wait exclusively, so one of them is woken, writers of records
+ * (different sizes) all re-check. Poll waiters are on poll_wait.
+ */
+static void globalfifo_wake(wait_queue_head_t *wq)
+{
+    if (wq_has_sleeper(wq))
+        wake_up_interruptible(wq);
+}
+
+/**
+ * Wake up all exclusive waiters as well, on state changes everyone has to re-check.
+ */
+static void globalfifo_wake_all(wait_queue_head_t *wq)
+{
+    if (wq_has_sleeper(wq))
+        wake_up_interruptible_all(wq);
+}
+
+/**
+ * Signal all attached eventfds, cheap list check when none is attached.
+ */
+static void globalfifo_signal_eventfd(struct globalfifo_dev *dev)
+{
+    struct globalfifo_file *file;
+
+    if (list_empty_careful(&dev->event_files))
+        return;
+
+    spin_lock(&dev->event_lock);
+    list_for_each_entry(file, &dev->event_files, event_node)
+        eventfd_signal(file->eventfd, 1);
+    spin_unlock(&dev->event_lock);
+}
+
+/**
+ * Report transition to readable (GLOBALFIFO_ARMED_IN) / writable (GLOBALFIFO_ARMED_OUT) after indices are
+ * published, to poll waiters (keyed, an epoll entry of the other direction is not woken) and eventfds, only
+ * if the FIFO was seen not ready since the previous report. The full barrier pairs with the one in
+ * globalfifo_check_ready(): either the checker sees the new index or we see its bit.
+ */
+static void globalfifo_notify(struct globalfifo_dev *dev, int bit)
+{
+    smp_mb();
+    if (!test_bit(bit, &dev->poll_armed) || !test_and_clear_bit(bit, &dev->poll_armed))
+        return;
+
+    if (wq_has_sleeper(&dev->poll_wait))
+        wake_up_interruptible_poll(&dev->poll_wait, bit == GLOBALFIFO_ARMED_IN ? EPOLLIN | EPOLLRDNORM :
+                                                                                 EPOLLOUT | EPOLLWRNORM);
+    globalfifo_signal_eventfd(dev);
+}
+
+/**
+ * Attach eventfd of fd to file (replacing previous one), or detach it if fd < 0.
+ */
+static int globalfifo_set_eventfd(struct globalfifo_file *file, int fd)
+{
+    struct globalfifo_dev *dev = file->dev;
+    struct eventfd_ctx *ctx = NULL, *old;
+
+    if (fd >= 0) {
+        ctx = eventfd_ctx_fdget(fd);
+        if (IS_ERR(ctx))
+            return PTR_ERR(ctx);
+    }
+
+    spin_lock(&dev->event_lock);
+    old = file->eventfd;
+    file->eventfd = ctx;
+    if (ctx && !old)
+        list_add_tail(&file->event_node, &dev->event_files);
+    else if (!ctx && old)
+        list_del_init(&file->event_node);
+    spin_unlock(&dev->event_lock);
+
+    if (old)
+        eventfd_ctx_put(old);
+    return 0;
+}
+
+/**
+ * Wake up readers and send SIGIO after write, only once used bytes reach read low-watermark.
+ * Poll waiters and eventfds are notified on the transition to readable only (coalesced, edge-triggered).
+ * Caller holds write_mutex.
+ */
+static void globalfifo_wake_readers(struct globalfifo_dev *dev, unsigned int used)
+{
+    unsigned int lowat = globalfifo_read_lowat(dev);
+
+    if (used < lowat) {
+        if (wq_has_sleeper(&dev->r_wait) || wq_has_sleeper(&dev->poll_wait) || dev->async_queue)
+            WRITE_ONCE(dev->read_wakeups_saved, dev->read_wakeups_saved + 1);
+        return;
+    }
+    globalfifo_notify(dev, GLOBALFIFO_ARMED_IN);
+
+    // Every broadcast reader needs the data, otherwise one exclusive waiter is enough.
+    if (globalfifo_broadcast(dev))
+        globalfifo_wake_all(&dev->r_wait);
+    else
+        globalfifo_wake(&dev->r_wait);
+
+    // Send SIGIO signal to inform data can be readout.
+    if (dev->async_queue) {
+        kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
+        pr_debug("%s kill SIGIO\n", __func__);
+    }
+}
+
+/**
+ * Wake up writers after read, only once free space reaches write high-watermark.
+ * Poll waiters and eventfds are notified on the transition to writable only. Caller holds read_mutex.
+ */
+static void globalfifo_wake_writers(struct globalfifo_dev *dev)
+{
+    unsigned int free = globalfifo_free(dev);
+    unsigned int lowat = globalfifo_write_lowat(dev);
+
+    if (free < lowat) {
+        if (wq_has_sleeper(&dev->w_wait) || wq_has_sleeper(&dev->poll_wait))
+            WRITE_ONCE(dev->write_wakeups_saved, dev->write_wakeups_saved + 1);
+        return;
+    }
+    globalfifo_notify(dev, GLOBALFIFO_ARMED_OUT);
+    globalfifo_wake(&dev->w_wait);
+}
+
+/**
+ * Count enqueue to dequeue latency in log2 histogram, caller holds read_mutex.
+ */
+static void globalfifo_account_latency(struct globalfifo_dev *dev, u64 ns)
+{
+    unsigned int bucket = ns ? min_t(unsigned int, ilog2(ns), GLOBALFIFO_HIST_BUCKETS - 1) : 0;
+
+    WRITE_ONCE(dev->latency_hist[bucket], dev->latency_hist[bucket] + 1);
+}
+
+/**
+ * Keep time of a write ending at ring index end, caller holds write_mutex.
+ */
+static void globalfifo_stamp_push(struct globalfifo_dev *dev, unsigned int end, u64 time)
+{
+    unsigned int head = dev->stamp_head;
+    struct globalfifo_stamp *stamp;
+
+    if (head - smp_load_acquire(&dev->stamp_tail) >= GLOBALFIFO_STAMPS)
+        return;
+    stamp = &dev->stamps[head & (GLOBALFIFO_STAMPS - 1)];
+    stamp->end = end;
+    stamp->time = time;
+    smp_store_release(&dev->stamp_head, head + 1);
+}
+
+/**
+ * Drop times of writes read completely once tail moved to ring index tail, their latency is counted
+ * unless data was discarded. Caller holds read_mutex.
+ */
+static void globalfifo_stamp_consume(struct globalfifo_dev *dev, unsigned int tail, bool account)
+{
+    unsigned int idx = dev->stamp_tail, head = smp_load_acquire(&dev->stamp_head);
+    struct globalfifo_stamp *stamp;
+    u64 now = ktime_get_ns();
+
+    for (; idx != head; idx++) {
+        stamp = &dev->stamps[idx & (GLOBALFIFO_STAMPS - 1)];
+        if ((int)(stamp->end - tail) > 0)
+            break;
+        if (account)
+            globalfifo_account_latency(dev, now - stamp->time);
+    }
+    smp_store_release(&dev->stamp_tail, idx);
+}
+
+/**
+ * Time of the write ending at ring index end, 0 if unknown. *idx is the stamp to start searching from,
+ * it is moved forward so that records in ring order are looked up in one pass. Caller holds read_mutex.
+ */
+static u64 globalfifo_stamp_find(struct globalfifo_dev *dev, unsigned int *idx, unsigned int end)
+{
+    unsigned int head = smp_load_acquire(&dev->stamp_head);
+    struct globalfifo_stamp *stamp;
+
+    for (; *idx != head; (*idx)++) {
+        stamp = &dev->stamps[*idx & (GLOBALFIFO_STAMPS - 1)];
+        if (stamp->end == end)
+            return stamp->time;
+        if ((int)(stamp->end - end) > 0)
+            break;
+    }
+    return 0;
+}
+
+/**
+ * Broadcast mode: move tail up to the slowest reader cursor, caller holds read_mutex.
+ * Without readers tail stays, so buffered data waits for the first reader.
+ */
+static void globalfifo_update_tail(struct globalfifo_dev *dev)
+{
+    struct globalfifo_file *file;
+    unsigned int tail = dev->ctrl->tail;
+    unsigned int ahead = UINT_MAX;
+
+    list_for_each_entry(file, &dev->readers, node) {
+        // Cursor behind tail has lost overwritten data, it reads from tail.
+        unsigned int delta = (int)(file->cursor - tail) > 0 ? file->cursor - tail : 0;
+
+        ahead = min(ahead, delta);
+    }
+
+    if (ahead != UINT_MAX && ahead != 0) {
+        smp_store_release(&dev->ctrl->tail, tail + ahead);
+        globalfifo_stamp_consume(dev, tail + ahead, true);
+        globalfifo_wake_writers(dev);
+    }
+}
+
+/**
+ * Overwrite-oldest: advance tail so that need bytes fit, by whole records in record mode.
+ * Caller holds read_mutex and write_mutex, readers behind new tail skip the lost data.
+ * Data a reader hasn't read yet (all of it without broadcast) is counted as dropped for it.
+ */
+static void globalfifo_drop_oldest(struct globalfifo_dev *dev, unsigned long need)
+{
+    unsigned int head = dev->ctrl->head;
+    unsigned int tail = dev->ctrl->tail;
+    unsigned int used = min_t(unsigned int, head - tail, dev->size);
+    unsigned int drop = 0, pos;
+    struct globalfifo_file *file;
+    __u32 len;
+
+    if (dev->size - used >= need)
+        return;
+
+    if (dev->mode & FIFO_MODE_RECORD) {
+        while (dev->size - used + drop < need && used - drop >= FIFO_RECORD_HDR_SIZE) {
+            list_for_each_entry(file, &dev->readers, node) {
+                if ((int)(tail + drop - globalfifo_read_pos(file)) >= 0)
+                    file->dropped_records++;
+            }
+            dev->dropped_records++;
+            globalfifo_ring_read(dev->mem, dev->size, tail + drop, &len, sizeof(len));
+            drop += min_t(unsigned int, FIFO_RECORD_HDR_SIZE + len, used - drop);
+        }
+    }
+    // Stream mode, or corrupted records written by mmap producer.
+    if (dev->size - used + drop < need)
+        drop = need - (dev->size - used);
+
+    list_for_each_entry(file, &dev->readers, node) {
+        pos = globalfifo_read_pos(file);
+        if ((int)(tail + drop - pos) > 0)
+            file->dropped_bytes += tail + drop - pos;
+    }
+    dev->dropped_bytes += drop;
+
+    smp_store_release(&dev->ctrl->tail, tail + drop);
+    globalfifo_stamp_consume(dev, tail + drop, false);
+}
+
+/**
+ * Wake up all writers of CPU rings and priority lanes, after records are discarded or mode changed.
+ */
+static void globalfifo_wake_shards(struct globalfifo_dev *dev)
+{
+    int cpu, prio;
+
+    for_each_possible_cpu(cpu)
+        globalfifo_wake_all(&per_cpu_ptr(dev->shards, cpu)->wait);
+    for (prio = 1; prio <= FIFO_PRIO_MAX; prio++)
+        globalfifo_wake_all(&globalfifo_lane(dev, prio)->ring.wait);
+}
+
+/**
+ * Give every CPU ring the FIFO capacity, allocated on the node of its CPU. Caller holds mode_sem for write
+ * and read_mutex, so CPU rings are empty and unused.
+ */
+static int globalfifo_alloc_shards(struct globalfifo_dev *dev)
+{
+    struct globalfifo_shard *shard;
+    unsigned char *mem;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        shard = per_cpu_ptr(dev->shards, cpu);
+        if (shard->mem && shard->size == dev->size)
+            continue;
+        mem = vmalloc_node(dev->size, cpu_to_node(cpu));
+        if (!mem)
+            return -ENOMEM;
+        vfree(shard->mem);
+        shard->mem = mem;
+        WRITE_ONCE(shard->size, dev->size);
+    }
+    return 0;
+}
+
+static int globalfifo_fasync(int fd, struct file *filp, int mode)
+{
+    // Invoked when FASYNC flag set via F_SETFL.
+    struct globalfifo_file *file = filp->private_data;
+    return fasync_helper(fd, filp, mode, &file->dev->async_queue);
+}
+
+static int globalfifo_open(struct inode *inode, struct file *filp)
+{
+    // Get device of this minor from embedded cdev.
+    struct globalfifo_dev *dev = container_of(inode->i_cdev, struct globalfifo_dev, cdev);
+    struct globalfifo_file *file;
+
+    file = kzalloc(sizeof(*file), GFP_KERNEL);
+    if (!file)
+        return -ENOMEM;
+    file->dev = dev;
+    INIT_LIST_HEAD(&file->node);
+    INIT_LIST_HEAD(&file->event_node);
+
+    /*
+    A read-only open is a broadcast reader from now on. A producer opened read / write only becomes one at
+    its first read, so that it doesn't hold back the slowest cursor (writers in block-slowest mode) forever.
+    */
+    if ((filp->f_mode & (FMODE_READ | FMODE_WRITE)) == FMODE_READ) {
+        mutex_lock(&dev->read_mutex);
+        globalfifo_add_reader(file);
+        mutex_unlock(&dev->read_mutex);
+    }
+
+    filp->private_data = file;
+    // read_iter / write_iter honor IOCB_NOWAIT, io_uring tries them inline and arms poll on -EAGAIN.
+    filp->f_mode |= FMODE_NOWAIT;
+    return 0;
+}
+
+static int globalfifo_release(struct inode *inode, struct file *filp)
+{
+    struct globalfifo_file *file = filp->private_data;
+    struct globalfifo_dev *dev = file->dev;
+
+    // Remove file from async notify table, detach eventfd.
+    globalfifo_fasync(-1, filp, 0);
+    globalfifo_set_eventfd(file, -1);
+
+    // Slowest broadcast reader leaving releases its data to writers.
+    mutex_lock(&dev->read_mutex);
+    if (!list_empty(&file->node)) {
+        list_del(&file->node);
+        if (globalfifo_broadcast(dev))
+            globalfifo_update_tail(dev);
+    }
+    mutex_unlock(&dev->read_mutex);
+    kfree(file);
+    return 0;
+}
+
+/**
+ * Replace data ring by a new one of size bytes (rounded up to power of two), buffered data is kept
+ * at the same indices. Fails with -EBUSY if buffered data doesn't fit or data ring is mapped.
+ */
+static int globalfifo_resize(struct globalfifo_dev *dev, unsigned long size)
+{
+    unsigned char *mem;
+    unsigned int head, tail, used, done, n;
+    int ret = 0;
+
+    if (size == 0 || size > GLOBALFIFO_SIZE_MAX)
+        return -EINVAL;
+    size = roundup_pow_of_two(size);
+
+    // Allocate outside of locks, readers / writers are blocked only for the copy.
+    mem = vmalloc_user(size);
+    if (!mem)
+        return -ENOMEM;
+
+    // Stop both sides, lock order: read_mutex -> write_mutex -> mmap_mutex.
+    mutex_lock(&dev->read_mutex);
+    mutex_lock(&dev->write_mutex);
+    mutex_lock(&dev->mmap_mutex);
+    head = READ_ONCE(dev->ctrl->head);
+    tail = READ_ONCE(dev->ctrl->tail);
+    used = min_t(unsigned int, head - tail, dev->size);
+    if (atomic_read(&dev->mmap_count) || used > size) {
+        ret = -EBUSY;
+    } else {
+        // Copy in segments bounded by wrap-around of old and new ring.
+        for (done = 0; done < used; done += n) {
+            unsigned int src = (tail + done) & (dev->size - 1);
+            unsigned int dst = (tail + done) & (size - 1);
+
+            n = min3(used - done, dev->size - src, (unsigned int)size - dst);
+            memcpy(mem + dst, dev->mem + src, n);
+        }
+        WRITE_ONCE(dev->ctrl->head, tail + used);
+        swap(dev->mem, mem);
+        WRITE_ONCE(dev->size, size);
+        WRITE_ONCE(dev->ctrl->size, size);
+    }
+    mutex_unlock(&dev->mmap_mutex);
+    mutex_unlock(&dev->write_mutex);
+    mutex_unlock(&dev->read_mutex);
+
+    // Free old ring on success, or new ring on failure.
+    vfree(mem);
+    if (!ret) {
+        globalfifo_wake_all(&dev->w_wait);
+        globalfifo_notify(dev, GLOBALFIFO_ARMED_OUT);
+    }
+
+    return ret;
+}
+
+/**
+ * Switch between byte stream and record mode, ring (and CPU rings, lanes) must be empty as framing differs.
+ */
+static int globalfifo_set_mode(struct globalfifo_dev *dev, unsigned int mode)
+{
+    struct globalfifo_file *reader;
+    int ret = 0;
+
+    if (mode & ~(FIFO_MODE_RECORD | FIFO_MODE_BATCH | FIFO_MODE_BROADCAST | FIFO_MODE_OVERWRITE |
+                 FIFO_MODE_PERCPU | FIFO_MODE_ORDERED | FIFO_MODE_TIMESTAMP))
+        return -EINVAL;
+    // Times are returned per record.
+    if ((mode & FIFO_MODE_TIMESTAMP) && !(mode & (FIFO_MODE_RECORD | FIFO_MODE_PERCPU)))
+        return -EINVAL;
+    if ((mode & FIFO_MODE_ORDERED) && !(mode & FIFO_MODE_PERCPU))
+        return -EINVAL;
+    if ((mode & FIFO_MODE_PERCPU) && (mode & (FIFO_MODE_BROADCAST | FIFO_MODE_OVERWRITE)))
+        return -EINVAL;
+
+    // Shard and lane writers hold mode_sem instead of write_mutex, wait for them to leave.
+    percpu_down_write(&dev->mode_sem);
+    mutex_lock(&dev->read_mutex);
+    mutex_lock(&dev->write_mutex);
+    if (globalfifo_used(dev) != 0 || globalfifo_shards_pending(dev) || globalfifo_lanes_pending(dev, FIFO_PRIO_NUM))
+        ret = -EBUSY;
+    else if (mode & FIFO_MODE_PERCPU)
+        ret = globalfifo_alloc_shards(dev);
+    if (!ret) {
+        // Broadcast readers start at the (empty) ring.
+        list_for_each_entry(reader, &dev->readers, node)
+            reader->cursor = dev->ctrl->tail;
+        WRITE_ONCE(dev->mode, mode);
+    }
+    mutex_unlock(&dev->write_mutex);
+    mutex_unlock(&dev->read_mutex);
+    percpu_up_write(&dev->mode_sem);
+
+    // Writers may wait for more space in stream mode than in record mode, or on a ring of the other mode.
+    globalfifo_wake_all(&dev->w_wait);
+    globalfifo_wake_shards(dev);
+    globalfifo_wake_all(&dev->poll_wait);
+
+    return ret;
+}
+
+static long globalfifo_ioctl(struct file *filp, unsigned int cmd,
+                             unsigned long arg)
+{
+    struct globalfifo_file *file = filp->private_data;
+    struct globalfifo_dev *dev = file->dev;
+    struct globalfifo_file *reader;
+    struct globalfifo_shard *shard;
+    struct fifo_prio_weights weights;
+    struct fifo_dropped dropped;
+    struct fifo_lowat lowat;
+    __u32 size;
+    __s32 efd;
+    int cpu, prio;
+
+    switch (cmd) {
+    case FIFO_CLEAR:
+        // Discard data as a reader does, writer is not blocked.
+        mutex_lock(&dev->read_mutex);
+        smp_store_release(&dev->ctrl->tail, smp_load_acquire(&dev->ctrl->head));
+        globalfifo_stamp_consume(dev, dev->ctrl->tail, false);
+        list_for_each_entry(reader, &dev->readers, node)
+            reader->cursor = dev->ctrl->tail;
+        for_each_possible_cpu(cpu) {
+            shard = per_cpu_ptr(dev->shards, cpu);
+            smp_store_release(&shard->tail, smp_load_acquire(&shard->head));
+        }
+        for (prio = 1; prio <= FIFO_PRIO_MAX; prio++) {
+            shard = &globalfifo_lane(dev, prio)->ring;
+            smp_store_release(&shard->tail, smp_load_acquire(&shard->head));
+        }
+        mutex_unlock(&dev->read_mutex);
+        globalfifo_wake_all(&dev->w_wait);
+        globalfifo_wake_shards(dev);
+        globalfifo_notify(dev, GLOBALFIFO_ARMED_OUT);
+
+        printk(KERN_INFO "globalfifo is set to zero\n");
+        break;
+
+    case FIFO_NOTIFY:
+        // mmap producer / consumer moved head / tail, sleepers re-check the ring and set flags again if needed.
+        WRITE_ONCE(dev->ctrl->reader_waiting, 0);
+        WRITE_ONCE(dev->ctrl->writer_waiting, 0);
+        globalfifo_wake_all(&dev->r_wait);
+        globalfifo_wake_all(&dev->w_wait);
+        globalfifo_wake_all(&dev->poll_wait);
+        globalfifo_signal_eventfd(dev);
+        if (dev->async_queue)
+            kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
+        break;
+
+    case FIFO_SET_SIZE:
+        if (get_user(size, (__u32 __user *)arg))
+            return -EFAULT;
+        pr_info("Resize globalfifo to %u bytes\n", size);
+        return globalfifo_resize(dev, size);
+
+    case FIFO_GET_SIZE:
+        return put_user(READ_ONCE(dev->size), (__u32 __user *)arg);
+
+    case FIFO_SET_MODE:
+        if (get_user(size, (__u32 __user *)arg))
+            return -EFAULT;
+        return globalfifo_set_mode(dev, size);
+
+    case FIFO_GET_MODE:
+        return put_user(READ_ONCE(dev->mode), (__u32 __user *)arg);
+
+    case FIFO_SET_LOWAT:
+        if (copy_from_user(&lowat, (void __user *)arg, sizeof(lowat)))
+            return -EFAULT;
+        WRITE_ONCE(dev->read_lowat, lowat.read);
+        WRITE_ONCE(dev->write_lowat, lowat.write);
+        // Sleepers re-check against new watermarks.
+        globalfifo_wake_all(&dev->r_wait);
+        globalfifo_wake_all(&dev->w_wait);
+        globalfifo_wake_all(&dev->poll_wait);
+        break;
+
+    case FIFO_SET_EVENTFD:
+        if (get_user(efd, (__s32 __user *)arg))
+            return -EFAULT;
+        return globalfifo_set_eventfd(file, efd);
+
+    case FIFO_GET_LOWAT:
+        lowat.read = READ_ONCE(dev->read_lowat);
+        lowat.write = READ_ONCE(dev->write_lowat);
+        if (copy_to_user((void __user *)arg, &lowat, sizeof(lowat)))
+            return -EFAULT;
+        break;
+
+    case FIFO_SET_PRIO:
+        if (get_user(size, (__u32 __user *)arg))
+            return -EFAULT;
+        if (size > FIFO_PRIO_MAX)
+            return -EINVAL;
+        WRITE_ONCE(file->prio, size);
+        break;
+
+    case FIFO_GET_PRIO:
+        return put_user(READ_ONCE(file->prio), (__u32 __user *)arg);
+
+    case FIFO_SET_WRITE_FLAGS:
+        if (get_user(size, (__u32 __user *)arg))
+            return -EFAULT;
+        if (size & ~(FIFO_WRITE_ATOMIC | FIFO_WRITE_ALL))
+            return -EINVAL;
+        WRITE_ONCE(file->write_flags, size);
+        break;
+
+    case FIFO_GET_WRITE_FLAGS:
+        return put_user(READ_ONCE(file->write_flags), (__u32 __user *)arg);
+
+    case FIFO_GET_DROPPED:
+        mutex_lock(&dev->read_mutex);
+        dropped.bytes = file->dropped_bytes;
+        dropped.records = file->dropped_records;
+        mutex_unlock(&dev->read_mutex);
+        if (copy_to_user((void __user *)arg, &dropped, sizeof(dropped)))
+            return -EFAULT;
+        break;
+
+    case FIFO_SET_WEIGHTS:
+        if (copy_from_user(&weights, (void __user *)arg, sizeof(weights)))
+            return -EFAULT;
+        mutex_lock(&dev->read_mutex);
+        for (prio = 1; prio <= FIFO_PRIO_MAX; prio++) {
+            globalfifo_lane(dev, prio)->weight = weights.weight[prio];
+            globalfifo_lane(dev, prio)->streak = 0;
+        }
+        mutex_unlock(&dev->read_mutex);
+        break;
+
+    case FIFO_GET_WEIGHTS:
+        memset(&weights, 0, sizeof(weights));
+        for (prio = 1; prio <= FIFO_PRIO_MAX; prio++)
+            weights.weight[prio] = READ_ONCE(globalfifo_lane(dev, prio)->weight);
+        if (copy_to_user((void __user *)arg, &weights, sizeof(weights)))
+            return -EFAULT;
+        break;
+
+    default:
+        return -EINVAL;
+    }
+    return 0;
+}
+
+static unsigned int globalfifo_poll(struct file *filp, poll_table *wait)
+{
+    unsigned int mask = 0;
+    struct globalfifo_file *file = filp->private_data;
+    struct globalfifo_dev *dev = file->dev;
+    unsigned int prio;
+    unsigned long need;
+
+    /*
+    Add poll wait queue into poll_table, it is only woken when the FIFO becomes readable / writable, so
+    edge-triggered epoll gets one event per transition. A not ready check arms the next notification.
+    */
+    poll_wait(filp, &dev->poll_wait, wait);
+
+    // Indices are published by release stores, no lock needed to snapshot them.
+    // Mark data can be read (not Empty).
+    if (globalfifo_check_ready(file, true, 1)) {
+        mask |= POLLIN | POLLRDNORM;
+    }
+
+    // Mark data can be write (not FULL, room for a 1-byte record in record mode or priority lane)
+    prio = READ_ONCE(file->prio);
+    need = prio ? 1 + sizeof(struct globalfifo_shard_hdr) : globalfifo_need(dev, 1);
+    if ((!prio && globalfifo_overwrite(dev)) || globalfifo_check_ready(file, false, need)) {
+        mask |= POLLOUT | POLLWRNORM;
+    }
 
-static int globalfifo_fasync(int fd, struct file *filp, int mode)
-{
-    // Invoked when FASYNC flag set via F_SETFL.
-    struct globalfifo_dev *dev = filp->private_data;
-    return fasync_helper(fd, filp, mode, &dev->async_queue);
+    return mask;
 }
 
-static int globalfifo_open(struct inode *inode, struct file *filp)
+/**
+ * Non-block access requested by O_NONBLOCK, or by async submitter (io_uring) with IOCB_NOWAIT.
+ */
+static bool globalfifo_nowait(struct kiocb *iocb)
 {
-    filp->private_data = globalfifo_devp;
-    return 0;
+    return (iocb->ki_filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
 }
 
-static int globalfifo_release(struct inode *inode, struct file *filp)
+/**
+ * Lock reader / writer side mutex, IOCB_NOWAIT caller gets -EAGAIN instead of sleeping on it.
+ */
+static int globalfifo_lock(struct mutex *mutex, struct kiocb *iocb)
 {
-    // Remove file from async notify table.
-    globalfifo_fasync(-1, filp, 0);
+    if (iocb->ki_flags & IOCB_NOWAIT) {
+        if (!mutex_trylock(mutex))
+            return -EAGAIN;
+    } else {
+        mutex_lock(mutex);
+    }
     return 0;
 }
 
-static long globalfifo_ioctl(struct file *filp, unsigned int cmd,
-                             unsigned long arg)
+/**
+ * Copy one record payload from ring to user, or in batch mode as many whole records as fit,
+ * each with its length header, in timestamp mode each prefixed by its write time.
+ * Return bytes copied, *consumed is set to ring bytes to release.
+ * A record larger than the user buffer is left in ring and -EMSGSIZE returned.
+ */
+static ssize_t globalfifo_read_records(struct globalfifo_dev *dev, unsigned int tail, unsigned int avail,
+                                       size_t count, struct iov_iter *to, unsigned int *consumed)
 {
-    struct globalfifo_dev *dev = filp->private_data;
+    bool batch = dev->mode & FIFO_MODE_BATCH;
+    bool stamped = dev->mode & FIFO_MODE_TIMESTAMP;
+    unsigned int extra = stamped ? FIFO_STAMP_SIZE : 0;
+    unsigned int pos = 0, idx = dev->stamp_tail;
+    size_t copied = 0;
+    __u32 len;
+    u64 time = 0;
 
-    switch (cmd) {
-    case FIFO_CLEAR:
-        mutex_lock(&dev->mutex);
-        dev->current_len = 0;
-        memset(dev->mem, 0, GLOBALFIFO_SIZE);
-        mutex_unlock(&dev->mutex);
+    // Find whole records fitting in user buffer, lengths written by mmap producer are untrusted.
+    while (avail - pos >= FIFO_RECORD_HDR_SIZE) {
+        globalfifo_ring_read(dev->mem, dev->size, tail + pos, &len, sizeof(len));
+        if (len > avail - pos - FIFO_RECORD_HDR_SIZE)
+            break;
+        if (stamped)
+            time = globalfifo_stamp_find(dev, &idx, tail + pos + FIFO_RECORD_HDR_SIZE + len);
+        if (!batch) {
+            if (extra + len > count)
+                return -EMSGSIZE;
+            if ((stamped && copy_to_iter(&time, sizeof(time), to) != sizeof(time)) ||
+                globalfifo_copy_to_iter(dev->mem, dev->size, tail + FIFO_RECORD_HDR_SIZE, len, to) != len)
+                return -EFAULT;
+            *consumed = FIFO_RECORD_HDR_SIZE + len;
+            return extra + len;
+        }
+        if (extra + FIFO_RECORD_HDR_SIZE + len > count - copied) {
+            if (copied == 0)
+                return -EMSGSIZE;
+            break;
+        }
+        // Timestamped records are copied one by one, each after its time.
+        if (stamped && (copy_to_iter(&time, sizeof(time), to) != sizeof(time) ||
+                        globalfifo_copy_to_iter(dev->mem, dev->size, tail + pos, FIFO_RECORD_HDR_SIZE + len, to) !=
+                            FIFO_RECORD_HDR_SIZE + len))
+            return -EFAULT;
+        pos += FIFO_RECORD_HDR_SIZE + len;
+        copied += extra + FIFO_RECORD_HDR_SIZE + len;
+    }
 
-        printk(KERN_INFO "globalfifo is set to zero\n");
-        break;
+    // Truncated or corrupted record.
+    if (pos == 0)
+        return -EIO;
 
-    default:
-        return -EINVAL;
+    // Whole records are contiguous in ring, copy them with headers at once.
+    if (!stamped && globalfifo_copy_to_iter(dev->mem, dev->size, tail, pos, to) != pos)
+        return -EFAULT;
+    *consumed = pos;
+    return copied;
+}
+
+static unsigned int globalfifo_next_cpu(unsigned int cpu)
+{
+    cpu = cpumask_next(cpu, cpu_possible_mask);
+    return cpu < nr_cpu_ids ? cpu : cpumask_first(cpu_possible_mask);
+}
+
+/**
+ * CPU ring to read next record from and its header, NULL if all are empty. Caller holds read_mutex.
+ * A ring is drained from dev->next_cpu on, ordered mode takes the lowest sequence number of all
+ * ring heads instead.
+ */
+static struct globalfifo_shard *globalfifo_next_shard(struct globalfifo_dev *dev, struct globalfifo_shard_hdr *hdr)
+{
+    bool ordered = dev->mode & FIFO_MODE_ORDERED;
+    struct globalfifo_shard *shard, *found = NULL;
+    struct globalfifo_shard_hdr h;
+    unsigned int cpu = dev->next_cpu, i;
+
+    for (i = 0; i < num_possible_cpus(); i++, cpu = globalfifo_next_cpu(cpu)) {
+        shard = per_cpu_ptr(dev->shards, cpu);
+        if (smp_load_acquire(&shard->head) == shard->tail)
+            continue;
+        globalfifo_ring_read(shard->mem, shard->size, shard->tail, &h, sizeof(h));
+        if (!found || h.seq < hdr->seq) {
+            found = shard;
+            *hdr = h;
+            dev->next_cpu = cpu;
+        }
+        if (!ordered)
+            break;
     }
-    return 0;
+    return found;
 }
 
-static unsigned int globalfifo_poll(struct file *filp, poll_table *wait)
+/**
+ * Copy head record (header hdr) of kernel ring to user, in batch mode with its FIFO_RECORD_HDR_SIZE
+ * length header like the FIFO ring, after its write time in timestamp mode. Returns bytes copied,
+ * -EMSGSIZE if more than room (record is kept). Caller holds read_mutex.
+ */
+static ssize_t globalfifo_shard_pop(struct globalfifo_dev *dev, struct globalfifo_shard *shard,
+                                    const struct globalfifo_shard_hdr *hdr, bool batch, size_t room,
+                                    struct iov_iter *to)
 {
-    unsigned int mask = 0;
-    struct globalfifo_dev *dev = filp->private_data;
+    bool stamped = dev->mode & FIFO_MODE_TIMESTAMP;
+    __u32 len = hdr->len;
+    u64 time = hdr->stamp;
+    size_t size = (stamped ? FIFO_STAMP_SIZE : 0) + (batch ? FIFO_RECORD_HDR_SIZE : 0) + len;
 
-    mutex_lock(&dev->mutex);
+    if (size > room)
+        return -EMSGSIZE;
+    if ((stamped && copy_to_iter(&time, sizeof(time), to) != sizeof(time)) ||
+        (batch && copy_to_iter(&len, sizeof(len), to) != sizeof(len)) ||
+        globalfifo_copy_to_iter(shard->mem, shard->size, shard->tail + sizeof(*hdr), len, to) != len)
+        return -EFAULT;
 
-    // Add read / write wait queue into poll_table.
-    poll_wait(filp, &dev->r_wait, wait);
-    poll_wait(filp, &dev->w_wait, wait);
+    // Release record to writers of the ring.
+    smp_store_release(&shard->tail, shard->tail + sizeof(*hdr) + len);
+    globalfifo_wake(&shard->wait);
+    globalfifo_notify(dev, GLOBALFIFO_ARMED_OUT);
+    globalfifo_account_latency(dev, ktime_get_ns() - time);
+    return size;
+}
 
-    // Mark data can be read (not Empty).
-    if (dev->current_len != 0) {
-        mask |= POLLIN | POLLRDNORM;
+/**
+ * Per-CPU mode: copy one record payload to user, or in batch mode as many whole records as fit, each with
+ * its length header. Caller holds read_mutex.
+ */
+static ssize_t globalfifo_read_shards(struct globalfifo_dev *dev, size_t count, struct iov_iter *to)
+{
+    bool batch = dev->mode & FIFO_MODE_BATCH;
+    struct globalfifo_shard *shard;
+    struct globalfifo_shard_hdr hdr;
+    size_t copied = 0;
+    ssize_t ret = 0;
+
+    while ((shard = globalfifo_next_shard(dev, &hdr)) != NULL) {
+        ret = globalfifo_shard_pop(dev, shard, &hdr, batch, count - copied, to);
+        if (ret < 0)
+            break;
+        copied += ret;
+        if (!batch)
+            break;
     }
 
-    // Mark data can be write (not FULL)
-    if (dev->current_len != GLOBALFIFO_SIZE) {
-        mask |= POLLOUT | POLLWRNORM;
+    // Next read starts from the next CPU, so that a busy CPU doesn't starve the others.
+    dev->next_cpu = globalfifo_next_cpu(dev->next_cpu);
+    return copied ? copied : ret;
+}
+
+/**
+ * Priority lane to read from, NULL for the FIFO ring. Caller holds read_mutex.
+ * Highest non-empty lane is served, unless it was served weight times in a row while lower lanes have data.
+ */
+static struct globalfifo_lane *globalfifo_next_lane(struct globalfifo_file *file)
+{
+    struct globalfifo_dev *dev = file->dev;
+    struct globalfifo_lane *lane;
+    unsigned int prio;
+    bool lower;
+
+    for (prio = FIFO_PRIO_MAX; prio > 0; prio--) {
+        lane = globalfifo_lane(dev, prio);
+        if (!globalfifo_shard_pending(&lane->ring)) {
+            lane->streak = 0;
+            continue;
+        }
+        if (lane->weight && lane->streak >= lane->weight) {
+            lower = globalfifo_lanes_pending(dev, prio) ||
+                    (globalfifo_percpu(dev) ? globalfifo_shards_pending(dev) :
+                                              smp_load_acquire(&dev->ctrl->head) != globalfifo_read_pos(file));
+            // Let one read through to lower lanes.
+            if (lower) {
+                lane->streak = 0;
+                continue;
+            }
+        }
+        lane->streak++;
+        return lane;
     }
+    return NULL;
+}
 
-    mutex_unlock(&dev->mutex);
-    return mask;
+/**
+ * Copy one record payload of priority lane to user, or in batch mode as many whole records of the lane
+ * as fit. Caller holds read_mutex.
+ */
+static ssize_t globalfifo_read_lane(struct globalfifo_dev *dev, struct globalfifo_lane *lane, size_t count,
+                                    struct iov_iter *to)
+{
+    bool batch = dev->mode & FIFO_MODE_BATCH;
+    struct globalfifo_shard_hdr hdr;
+    u64 now = ktime_get_ns(), latency;
+    size_t copied = 0;
+    ssize_t ret = 0;
+
+    while (globalfifo_shard_pending(&lane->ring)) {
+        globalfifo_ring_read(lane->ring.mem, lane->ring.size, lane->ring.tail, &hdr, sizeof(hdr));
+        ret = globalfifo_shard_pop(dev, &lane->ring, &hdr, batch, count - copied, to);
+        if (ret < 0)
+            break;
+        copied += ret;
+
+        latency = now - hdr.stamp;
+        WRITE_ONCE(lane->records, lane->records + 1);
+        WRITE_ONCE(lane->latency_sum, lane->latency_sum + latency);
+        if (latency > lane->latency_max)
+            WRITE_ONCE(lane->latency_max, latency);
+        if (!batch)
+            break;
+    }
+    return copied ? copied : ret;
 }
 
-static ssize_t globalfifo_read(struct file *filp, char __user *buf,
-                               size_t count, loff_t *ppos)
+static ssize_t globalfifo_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
-    int ret;
-    struct globalfifo_dev *dev = filp->private_data;
-    // Declare wait queue.
-    DECLARE_WAITQUEUE(wait, current);
+    ssize_t ret;
+    size_t count = iov_iter_count(to);
+    struct globalfifo_file *file = iocb->ki_filp->private_data;
+    struct globalfifo_dev *dev = file->dev;
+    struct globalfifo_lane *lane;
+    unsigned int head, tail, avail, consumed;
 
-    mutex_lock(&dev->mutex);
-    // Add current task struct to wait queue.
-    add_wait_queue(&dev->r_wait, &wait);
+    if (count == 0)
+        return 0;
+    if (globalfifo_lock(&dev->read_mutex, iocb))
+        return -EAGAIN;
+    if (list_empty(&file->node))
+        globalfifo_add_reader(file);
 
     // Check if possible to read.
-    while (dev->current_len == 0) {
+    while (!globalfifo_check_ready(file, true, 1)) {
+        mutex_unlock(&dev->read_mutex);
+
         // If non-block flag set, return error Try Again.
-        if (filp->f_flags & O_NONBLOCK) {
-            ret = -EAGAIN;
-            goto out;
-        }
-        // Change process state to INTERRUPTIBLE (light sleep) and could be wakeup by signal.
-        __set_current_state(TASK_INTERRUPTIBLE);
-        mutex_unlock(&dev->mutex);
-
-        // Switch to other process running.
-        schedule();
-        if (signal_pending(current)) {
-            // Return Restart error if wakeup by signal.
-            ret = -ERESTARTSYS;
-            goto out2;
-        }
+        if (globalfifo_nowait(iocb))
+            return -EAGAIN;
 
-        mutex_lock(&dev->mutex);
-    }
+        /*
+        Exclusive wait, a write wakes one reader instead of all blocked readers (thundering herd).
+        Ring is checked without read_mutex, writer doesn't take it. Return Restart error if wakeup by signal.
+        */
+        if (wait_event_interruptible_exclusive(dev->r_wait, globalfifo_check_ready(file, true, 1)))
+            return -ERESTARTSYS;
 
-    if (count > dev->current_len)
-        count = dev->current_len;
+        mutex_lock(&dev->read_mutex);
+    }
 
-    if (copy_to_user(buf, dev->mem, count)) {
-        ret = -EFAULT;
+    lane = globalfifo_next_lane(file);
+    if (lane || globalfifo_percpu(dev)) {
+        ret = lane ? globalfifo_read_lane(dev, lane, count, to) : globalfifo_read_shards(dev, count, to);
+        // Pass exclusive wakeup on to next reader if records are left.
+        if (ret >= 0 && globalfifo_ready(file, true, globalfifo_read_lowat(dev)))
+            globalfifo_wake(&dev->r_wait);
         goto out;
+    }
+
+    // Broadcast reader reads from its own cursor, data stays for other readers.
+    tail = globalfifo_read_pos(file);
+    head = smp_load_acquire(&dev->ctrl->head);
+    avail = min_t(unsigned int, head - tail, dev->size);
+
+    if (dev->mode & FIFO_MODE_RECORD) {
+        ret = globalfifo_read_records(dev, tail, avail, count, to, &consumed);
+        if (ret < 0)
+            goto out;
+    } else {
+        // Only bytes copied before an invalid user address are consumed.
+        consumed = globalfifo_copy_to_iter(dev->mem, dev->size, tail, min_t(size_t, count, avail), to);
+        if (consumed == 0) {
+            ret = -EFAULT;
+            goto out;
+        }
+        ret = consumed;
+    }
+
+    pr_debug("read %zd bytes(s),current_len:%u\n", ret, avail - consumed);
+    if (globalfifo_broadcast(dev)) {
+        file->cursor = tail + consumed;
+        globalfifo_update_tail(dev);
     } else {
-        memcpy(dev->mem, dev->mem + count, dev->current_len - count);
-        dev->current_len -= count;
-        printk(KERN_INFO "read %d bytes(s),current_len:%d\n", count,
-               dev->current_len);
+        // Publish consumed space after data is copied out.
+        smp_store_release(&dev->ctrl->tail, tail + consumed);
+        globalfifo_stamp_consume(dev, tail + consumed, true);
 
         // Wakeup possible write blocking process after read out data.
-        wake_up_interruptible(&dev->w_wait);
+        globalfifo_wake_writers(dev);
 
-        ret = count;
+        // Pass exclusive wakeup on to next reader if data is left.
+        if (avail - consumed >= globalfifo_read_lowat(dev) || globalfifo_lanes_pending(dev, FIFO_PRIO_NUM))
+            globalfifo_wake(&dev->r_wait);
     }
+
 out:
-    mutex_unlock(&dev->mutex);
-out2:
-    // Remove from wait queue.
-    remove_wait_queue(&dev->r_wait, &wait);
-    // Set process tate to RUNNING.
-    set_current_state(TASK_RUNNING);
+    mutex_unlock(&dev->read_mutex);
     return ret;
 }
 
-static ssize_t globalfifo_write(struct file *filp, const char __user *buf,
-                                size_t count, loff_t *ppos)
+/**
+ * Lock writer side. Overwrite-oldest writer moves tail as well, so it also takes read_mutex
+ * (lock order: read_mutex -> write_mutex) and *overwrite is set, mode is stable once locked.
+ * Returns -ESTALE without locks if the mode became per-CPU meanwhile.
+ */
+static int globalfifo_lock_writer(struct globalfifo_dev *dev, struct kiocb *iocb, bool *overwrite)
 {
-    struct globalfifo_dev *dev = filp->private_data;
-    int ret;
-    DECLARE_WAITQUEUE(wait, current);
+    while (1) {
+        *overwrite = globalfifo_overwrite(dev);
+        if (*overwrite && globalfifo_lock(&dev->read_mutex, iocb))
+            return -EAGAIN;
+        if (globalfifo_lock(&dev->write_mutex, iocb)) {
+            if (*overwrite)
+                mutex_unlock(&dev->read_mutex);
+            return -EAGAIN;
+        }
+        if (*overwrite == globalfifo_overwrite(dev) && !globalfifo_percpu(dev))
+            return 0;
 
-    mutex_lock(&dev->mutex);
-    add_wait_queue(&dev->w_wait, &wait);
+        // Mode changed before locks were taken, retry.
+        mutex_unlock(&dev->write_mutex);
+        if (*overwrite)
+            mutex_unlock(&dev->read_mutex);
+        if (globalfifo_percpu(dev))
+            return -ESTALE;
+    }
+}
 
-    while (dev->current_len == GLOBALFIFO_SIZE) {
-        if (filp->f_flags & O_NONBLOCK) {
-            ret = -EAGAIN;
+static void globalfifo_unlock_writer(struct globalfifo_dev *dev, bool overwrite)
+{
+    mutex_unlock(&dev->write_mutex);
+    if (overwrite)
+        mutex_unlock(&dev->read_mutex);
+}
+
+/**
+ * Ring space a write of count bytes waits for, the whole write with FIFO_WRITE_ATOMIC in stream mode.
+ */
+static unsigned long globalfifo_write_need(struct globalfifo_file *file, size_t count)
+{
+    struct globalfifo_dev *dev = file->dev;
+
+    if (!(READ_ONCE(dev->mode) & (FIFO_MODE_RECORD | FIFO_MODE_PERCPU)) &&
+        (READ_ONCE(file->write_flags) & FIFO_WRITE_ATOMIC))
+        return count;
+    return globalfifo_need(dev, count);
+}
+
+/**
+ * Writer can go on: there is room for count bytes (at least write high-watermark), or the write
+ * never fits the ring.
+ */
+static bool globalfifo_write_ready(struct globalfifo_file *file, size_t count)
+{
+    unsigned long need = globalfifo_write_need(file, count);
+
+    return need > READ_ONCE(file->dev->size) || globalfifo_check_ready(file, false, need);
+}
+
+/**
+ * Write to the shared ring. Returns -ESTALE before anything is written if the mode became per-CPU.
+ * With FIFO_WRITE_ALL a stream write goes on in chunks as space is freed, an error after some bytes
+ * are written returns their count.
+ */
+static ssize_t globalfifo_write_ring(struct globalfifo_file *file, struct kiocb *iocb, struct iov_iter *from)
+{
+    struct globalfifo_dev *dev = file->dev;
+    bool write_all = READ_ONCE(file->write_flags) & FIFO_WRITE_ALL;
+    size_t count = iov_iter_count(from);
+    unsigned int head, tail, used, written;
+    unsigned long need;
+    size_t total = 0;
+    bool overwrite;
+    ssize_t ret;
+
+    ret = globalfifo_lock_writer(dev, iocb, &overwrite);
+    if (ret)
+        return ret;
+
+    while (1) {
+        // Mode and size may change while sleeping, a record never fitting the ring is rejected.
+        need = globalfifo_write_need(file, count);
+        if (need > dev->size) {
+            ret = -EMSGSIZE;
             goto out;
         }
-        __set_current_state(TASK_INTERRUPTIBLE);
+        // Overwrite-oldest never waits, make room for the whole write (up to ring capacity).
+        if (overwrite) {
+            globalfifo_drop_oldest(dev, dev->mode & FIFO_MODE_RECORD ? need : min_t(size_t, count, dev->size));
+        } else if (!globalfifo_check_ready(file, false, need)) {
+            globalfifo_unlock_writer(dev, overwrite);
 
-        mutex_unlock(&dev->mutex);
+            if (globalfifo_nowait(iocb))
+                return total ? total : -EAGAIN;
 
-        schedule();
-        if (signal_pending(current)) {
-            ret = -ERESTARTSYS;
-            goto out2;
+            /*
+            Byte stream writers all wait for the same space (write watermark), so a read wakes one exclusive
+            waiter. Records and atomic writes wait for their own size: an exclusive waiter which still doesn't
+            fit would swallow the wakeup of a smaller one, so they wait non-exclusively and all re-check.
+            An exclusive waiter leaves once its need changes with the mode, and waits again here.
+            */
+            if (globalfifo_write_need(file, count) == 1)
+                ret = wait_event_interruptible_exclusive(dev->w_wait, globalfifo_write_ready(file, count) ||
+                                                                      globalfifo_write_need(file, count) != 1);
+            else
+                ret = wait_event_interruptible(dev->w_wait, globalfifo_write_ready(file, count));
+            if (ret)
+                return total ? total : -ERESTARTSYS;
+
+            ret = globalfifo_lock_writer(dev, iocb, &overwrite);
+            if (ret)
+                return total ? total : ret;
+            continue;
+        }
+
+        head = READ_ONCE(dev->ctrl->head);
+        tail = smp_load_acquire(&dev->ctrl->tail);
+
+        if (dev->mode & FIFO_MODE_RECORD) {
+            // Whole record or nothing, header is written after payload is copied in.
+            __u32 len = count;
+
+            if (globalfifo_copy_from_iter(dev->mem, dev->size, head + FIFO_RECORD_HDR_SIZE, count, from) != count) {
+                ret = -EFAULT;
+                goto out;
+            }
+            globalfifo_ring_write(dev->mem, dev->size, head, &len, sizeof(len));
+            written = need;
+        } else {
+            count = min_t(size_t, count, dev->size - min_t(unsigned int, head - tail, dev->size));
+            count = globalfifo_copy_from_iter(dev->mem, dev->size, head, count, from);
+            if (count == 0) {
+                ret = -EFAULT;
+                goto out;
+            }
+            written = count;
         }
+        total += count;
+
+        // Publish data to reader after it is copied in, with its write time.
+        globalfifo_stamp_push(dev, head + written, ktime_get_ns());
+        smp_store_release(&dev->ctrl->head, head + written);
+        used = min_t(unsigned int, head + written - tail, dev->size);
+        if (used > dev->high_water)
+            WRITE_ONCE(dev->high_water, used);
+        pr_debug("written %zu bytes(s),current_len:%u\n", count, used);
+
+        globalfifo_wake_readers(dev, used);
+
+        // Pass exclusive wakeup on to next writer if space is left.
+        if (dev->size - used >= globalfifo_write_lowat(dev))
+            globalfifo_wake(&dev->w_wait);
 
-        mutex_lock(&dev->mutex);
+        // Stream write-all goes on with the rest instead of returning a short count.
+        count = iov_iter_count(from);
+        if (!write_all || count == 0 || (dev->mode & FIFO_MODE_RECORD))
+            break;
     }
+out:
+    globalfifo_unlock_writer(dev, overwrite);
+    return total ? total : ret;
+}
+
+/**
+ * Append the write as one record to priority lane prio, or with prio 0 in per-CPU mode to the ring of
+ * current CPU. Writers on different CPUs share no lock, shard lock is only contended by writers preempted
+ * or migrated on the same ring. Returns -ESTALE before anything is written if the mode is no longer per-CPU.
+ */
+static ssize_t globalfifo_write_shard(struct globalfifo_file *file, struct kiocb *iocb, struct iov_iter *from,
+                                      unsigned int prio)
+{
+    struct globalfifo_dev *dev = file->dev;
+    struct globalfifo_shard *shard = prio ? &globalfifo_lane(dev, prio)->ring :
+                                            per_cpu_ptr(dev->shards, raw_smp_processor_id());
+    struct globalfifo_shard_hdr hdr = {};
+    size_t count = iov_iter_count(from);
+    unsigned long need = count + sizeof(hdr);
+    unsigned int head;
+    ssize_t ret;
+
+    while (1) {
+        if (iocb->ki_flags & IOCB_NOWAIT) {
+            if (!percpu_down_read_trylock(&dev->mode_sem))
+                return -EAGAIN;
+        } else {
+            percpu_down_read(&dev->mode_sem);
+        }
+
+        // Mode and ring size are stable while mode_sem is held.
+        if (!prio && !globalfifo_percpu(dev)) {
+            ret = -ESTALE;
+            goto out_sem;
+        }
+        // Every broadcast reader would need its own copy of urgent records.
+        if (prio && globalfifo_broadcast(dev)) {
+            ret = -EINVAL;
+            goto out_sem;
+        }
+        if (need > shard->size) {
+            ret = -EMSGSIZE;
+            goto out_sem;
+        }
+        if (globalfifo_lock(&shard->lock, iocb)) {
+            ret = -EAGAIN;
+            goto out_sem;
+        }
+        if (globalfifo_shard_free(shard) >= need)
+            break;
+        mutex_unlock(&shard->lock);
+        percpu_up_read(&dev->mode_sem);
+
+        if (globalfifo_nowait(iocb))
+            return -EAGAIN;
 
-    if (count > GLOBALFIFO_SIZE - dev->current_len)
-        count = GLOBALFIFO_SIZE - dev->current_len;
+        /*
+        Wait for the reader to drain this ring, mode_sem is not held while sleeping. Not exclusive: writers
+        of records need different space, a woken one which doesn't fit must not keep a smaller one asleep.
+        */
+        if (wait_event_interruptible(shard->wait, (!prio && !globalfifo_percpu(dev)) ||
+                                                  globalfifo_shard_free(shard) >= need))
+            return -ERESTARTSYS;
+    }
 
-    if (copy_from_user(dev->mem + dev->current_len, buf, count)) {
+    head = shard->head;
+    if (globalfifo_copy_from_iter(shard->mem, shard->size, head + sizeof(hdr), count, from) != count) {
         ret = -EFAULT;
         goto out;
-    } else {
-        dev->current_len += count;
-        printk(KERN_INFO "written %d bytes(s),current_len:%d\n", count,
-               dev->current_len);
+    }
+    // Numbered under shard lock, so sequence grows along each ring.
+    hdr.len = count;
+    hdr.stamp = ktime_get_ns();
+    if (!prio && (dev->mode & FIFO_MODE_ORDERED))
+        hdr.seq = atomic64_inc_return(&dev->seq);
+    globalfifo_ring_write(shard->mem, shard->size, head, &hdr, sizeof(hdr));
+    smp_store_release(&shard->head, head + need);
+    ret = count;
+
+out:
+    mutex_unlock(&shard->lock);
+out_sem:
+    percpu_up_read(&dev->mode_sem);
+    if (ret < 0)
+        return ret;
 
-        wake_up_interruptible(&dev->r_wait);
+    globalfifo_wake(&dev->r_wait);
+    globalfifo_notify(dev, GLOBALFIFO_ARMED_IN);
+    if (dev->async_queue)
+        kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
 
-        // Send SIGIO signal to inform data can be readout.
-        if (dev->async_queue) {
-            kill_fasync(&dev->async_queue, SIGIO, POLL_IN);
-            printk(KERN_DEBUG "%s kill SIGIO\n", __func__);
-        }
+    return ret;
+}
+
+static ssize_t globalfifo_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    struct globalfifo_file *file = iocb->ki_filp->private_data;
+    unsigned int prio;
+    ssize_t ret;
+
+    if (iov_iter_count(from) == 0)
+        return 0;
+
+    prio = READ_ONCE(file->prio);
+    if (prio)
+        return globalfifo_write_shard(file, iocb, from, prio);
+
+    // Mode is only stable once the writer holds its locks, -ESTALE retries on the other path.
+    do {
+        if (globalfifo_percpu(file->dev))
+            ret = globalfifo_write_shard(file, iocb, from, 0);
+        else
+            ret = globalfifo_write_ring(file, iocb, from);
+    } while (ret == -ESTALE);
+
+    return ret;
+}
+
+static void globalfifo_vma_open(struct vm_area_struct *vma)
+{
+    struct globalfifo_dev *dev = vma->vm_private_data;
+
+    atomic_inc(&dev->mmap_count);
+}
+
+static void globalfifo_vma_close(struct vm_area_struct *vma)
+{
+    struct globalfifo_dev *dev = vma->vm_private_data;
+
+    atomic_dec(&dev->mmap_count);
+}
+
+static const struct vm_operations_struct globalfifo_vm_ops = {
+    .open = globalfifo_vma_open,
+    .close = globalfifo_vma_close,
+};
+
+/**
+ * Map control page (offset 0) or data ring (offset ctrl->data_offset).
+ * Data ring mappings are counted, so that resize doesn't free pages still mapped.
+ */
+static int globalfifo_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct globalfifo_file *file = filp->private_data;
+    struct globalfifo_dev *dev = file->dev;
+    int ret;
+
+    if (vma->vm_pgoff == 0)
+        return remap_vmalloc_range(vma, dev->ctrl, 0);
 
-        ret = count;
+    mutex_lock(&dev->mmap_mutex);
+    ret = remap_vmalloc_range(vma, dev->mem, vma->vm_pgoff - 1);
+    if (!ret) {
+        vma->vm_ops = &globalfifo_vm_ops;
+        vma->vm_private_data = dev;
+        globalfifo_vma_open(vma);
     }
+    mutex_unlock(&dev->mmap_mutex);
 
-out:
-    mutex_unlock(&dev->mutex);
-out2:
-    remove_wait_queue(&dev->w_wait, &wait);
-    set_current_state(TASK_RUNNING);
     return ret;
 }
 
+static ssize_t capacity_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    return sprintf(buf, "%u\n", READ_ONCE(dev->size));
+}
+
+/**
+ * Resize ring by writing new capacity (bytes).
+ */
+static ssize_t capacity_store(struct device *d, struct device_attribute *attr,
+                              const char *buf, size_t count)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+    unsigned long size;
+    int ret;
+
+    ret = kstrtoul(buf, 0, &size);
+    if (ret)
+        return ret;
+    ret = globalfifo_resize(dev, size);
+    return ret ? ret : count;
+}
+
+static ssize_t high_water_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    return sprintf(buf, "%u\n", READ_ONCE(dev->high_water));
+}
+
+/**
+ * Writing any value resets high-water mark.
+ */
+static ssize_t high_water_store(struct device *d, struct device_attribute *attr,
+                                const char *buf, size_t count)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    WRITE_ONCE(dev->high_water, 0);
+    return count;
+}
+
+/**
+ * Wakeups skipped by watermarks "<reader> <writer>", writing any value resets them.
+ */
+static ssize_t wakeups_saved_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    return sprintf(buf, "%lu %lu\n", READ_ONCE(dev->read_wakeups_saved), READ_ONCE(dev->write_wakeups_saved));
+}
+
+static ssize_t wakeups_saved_store(struct device *d, struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    WRITE_ONCE(dev->read_wakeups_saved, 0);
+    WRITE_ONCE(dev->write_wakeups_saved, 0);
+    return count;
+}
+
+/**
+ * One line per priority lane "<prio> <bytes buffered> <records read> <avg latency ns> <max latency ns>",
+ * writing any value resets the counters.
+ */
+static ssize_t lanes_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+    struct globalfifo_lane *lane;
+    unsigned long records;
+    unsigned int prio;
+    ssize_t len = 0;
+
+    for (prio = FIFO_PRIO_MAX; prio > 0; prio--) {
+        lane = globalfifo_lane(dev, prio);
+        records = READ_ONCE(lane->records);
+        len += sprintf(buf + len, "%u %u %lu %llu %llu\n", prio,
+                       smp_load_acquire(&lane->ring.head) - READ_ONCE(lane->ring.tail), records,
+                       records ? div64_ul(READ_ONCE(lane->latency_sum), records) : 0,
+                       READ_ONCE(lane->latency_max));
+    }
+    return len;
+}
+
+static ssize_t lanes_store(struct device *d, struct device_attribute *attr,
+                           const char *buf, size_t count)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+    struct globalfifo_lane *lane;
+    unsigned int prio;
+
+    mutex_lock(&dev->read_mutex);
+    for (prio = 1; prio <= FIFO_PRIO_MAX; prio++) {
+        lane = globalfifo_lane(dev, prio);
+        lane->records = 0;
+        lane->latency_sum = 0;
+        lane->latency_max = 0;
+    }
+    mutex_unlock(&dev->read_mutex);
+    return count;
+}
+
+/**
+ * Enqueue to dequeue latency histogram, one line "<from ns> <reads>" per non-empty log2 bucket,
+ * writing any value resets it.
+ */
+static ssize_t latency_hist_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+    unsigned long count;
+    ssize_t len = 0;
+    int i;
+
+    for (i = 0; i < GLOBALFIFO_HIST_BUCKETS; i++) {
+        count = READ_ONCE(dev->latency_hist[i]);
+        if (count)
+            len += sprintf(buf + len, "%llu %lu\n", i ? 1ULL << i : 0ULL, count);
+    }
+    return len;
+}
+
+static ssize_t latency_hist_store(struct device *d, struct device_attribute *attr,
+                                  const char *buf, size_t count)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    mutex_lock(&dev->read_mutex);
+    memset(dev->latency_hist, 0, sizeof(dev->latency_hist));
+    mutex_unlock(&dev->read_mutex);
+    return count;
+}
+
+/**
+ * Data dropped by overwrite-oldest writers "<bytes> <records>", writing any value resets it.
+ */
+static ssize_t dropped_show(struct device *d, struct device_attribute *attr, char *buf)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+    u64 bytes, records;
+
+    mutex_lock(&dev->read_mutex);
+    bytes = dev->dropped_bytes;
+    records = dev->dropped_records;
+    mutex_unlock(&dev->read_mutex);
+    return sprintf(buf, "%llu %llu\n", bytes, records);
+}
+
+static ssize_t dropped_store(struct device *d, struct device_attribute *attr,
+                             const char *buf, size_t count)
+{
+    struct globalfifo_dev *dev = dev_get_drvdata(d);
+
+    mutex_lock(&dev->read_mutex);
+    dev->dropped_bytes = 0;
+    dev->dropped_records = 0;
+    mutex_unlock(&dev->read_mutex);
+    return count;
+}
+
+static DEVICE_ATTR_RW(capacity);
+static DEVICE_ATTR_RW(high_water);
+static DEVICE_ATTR_RW(wakeups_saved);
+static DEVICE_ATTR_RW(lanes);
+static DEVICE_ATTR_RW(latency_hist);
+static DEVICE_ATTR_RW(dropped);
+
+static struct attribute *globalfifo_attrs[] = {
+    &dev_attr_capacity.attr,
+    &dev_attr_high_water.attr,
+    &dev_attr_wakeups_saved.attr,
+    &dev_attr_lanes.attr,
+    &dev_attr_latency_hist.attr,
+    &dev_attr_dropped.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(globalfifo);
+
 static const struct file_operations globalfifo_fops = {
     .owner = THIS_MODULE,
-    .read = globalfifo_read,
-    .write = globalfifo_write,
+    .read_iter = globalfifo_read_iter,
+    .write_iter = globalfifo_write_iter,
+    .splice_read = generic_file_splice_read, // splice() / sendfile() without user space copy, via read_iter.
+    .splice_write = iter_file_splice_write,  // splice() from pipe, via write_iter.
     .unlocked_ioctl = globalfifo_ioctl,
     .poll = globalfifo_poll,
+    .mmap = globalfifo_mmap,
     .fasync = globalfifo_fasync,
     .open = globalfifo_open,
     .release = globalfifo_release,
 };
 
-static void globalfifo_setup_cdev(struct globalfifo_dev *dev, int index)
+/**
+ * Device nodes are created with rw permission for all, as mknod -m 666 did.
+ */
+static char *globalfifo_devnode(struct device *dev, umode_t *mode)
+{
+    if (mode)
+        *mode = 0666;
+    return NULL;
+}
+
+/**
+ * Allocate ring of one FIFO instance, add its cdev and create /dev/globalfifo<index>.
+ */
+static int globalfifo_setup_dev(struct globalfifo_dev *dev, int index)
 {
-    int err, devno = MKDEV(globalfifo_major, index);
+    int ret, cpu, prio;
+    dev_t devno = MKDEV(globalfifo_major, index);
+    struct device *device;
+    struct globalfifo_shard *shard;
+
+    dev->size = roundup_pow_of_two(globalfifo_size);
+
+    // Page zeroed, mappable control page and data ring. CPU rings get memory once per-CPU mode is set.
+    dev->ctrl = vmalloc_user(sizeof(struct globalfifo_ctrl));
+    dev->mem = vmalloc_user(dev->size);
+    dev->shards = alloc_percpu(struct globalfifo_shard);
+    dev->stamps = kcalloc(GLOBALFIFO_STAMPS, sizeof(struct globalfifo_stamp), GFP_KERNEL);
+    if (!dev->ctrl || !dev->mem || !dev->shards || !dev->stamps) {
+        ret = -ENOMEM;
+        goto fail_ring;
+    }
+    for (prio = 1; prio <= FIFO_PRIO_MAX; prio++) {
+        shard = &globalfifo_lane(dev, prio)->ring;
+        shard->size = roundup_pow_of_two(globalfifo_lane_size);
+        shard->mem = vmalloc(shard->size);
+        if (!shard->mem) {
+            ret = -ENOMEM;
+            goto fail_ring;
+        }
+    }
+    dev->ctrl->size = dev->size;
+    dev->ctrl->data_offset = PAGE_SIZE;
+
+    ret = percpu_init_rwsem(&dev->mode_sem);
+    if (ret)
+        goto fail_ring;
+
+    // Device is live once added, initialize locks before.
+    mutex_init(&dev->read_mutex);
+    mutex_init(&dev->write_mutex);
+    mutex_init(&dev->mmap_mutex);
+    init_waitqueue_head(&dev->r_wait);
+    init_waitqueue_head(&dev->w_wait);
+    init_waitqueue_head(&dev->poll_wait);
+    // Nobody has polled yet, first transitions are reported.
+    dev->poll_armed = BIT(GLOBALFIFO_ARMED_IN) | BIT(GLOBALFIFO_ARMED_OUT);
+    INIT_LIST_HEAD(&dev->readers);
+    spin_lock_init(&dev->event_lock);
+    INIT_LIST_HEAD(&dev->event_files);
+    for_each_possible_cpu(cpu) {
+        shard = per_cpu_ptr(dev->shards, cpu);
+        mutex_init(&shard->lock);
+        init_waitqueue_head(&shard->wait);
+    }
+    for (prio = 1; prio <= FIFO_PRIO_MAX; prio++) {
+        shard = &globalfifo_lane(dev, prio)->ring;
+        mutex_init(&shard->lock);
+        init_waitqueue_head(&shard->wait);
+    }
+    dev->next_cpu = cpumask_first(cpu_possible_mask);
 
     cdev_init(&dev->cdev, &globalfifo_fops);
     dev->cdev.owner = THIS_MODULE;
-    err = cdev_add(&dev->cdev, devno, 1);
-    if (err)
-        printk(KERN_NOTICE "Error %d adding globalfifo%d", err, index);
+    ret = cdev_add(&dev->cdev, devno, 1);
+    if (ret) {
+        printk(KERN_NOTICE "Error %d adding globalfifo%d", ret, index);
+        goto fail_sem;
+    }
+
+    // Creating device with capacity / high_water attributes: /sys/class/globalfifo/globalfifo<index>
+    device = device_create(globalfifo_class, NULL, devno, dev, "globalfifo%d", index);
+    if (IS_ERR(device)) {
+        ret = PTR_ERR(device);
+        goto fail_device;
+    }
+
+    return 0;
+
+fail_device:
+    cdev_del(&dev->cdev);
+fail_sem:
+    percpu_free_rwsem(&dev->mode_sem);
+fail_ring:
+    for (prio = 1; prio <= FIFO_PRIO_MAX; prio++)
+        vfree(globalfifo_lane(dev, prio)->ring.mem);
+    kfree(dev->stamps);
+    free_percpu(dev->shards);
+    vfree(dev->mem);
+    vfree(dev->ctrl);
+    return ret;
+}
+
+static void globalfifo_remove_dev(struct globalfifo_dev *dev, int index)
+{
+    int cpu, prio;
+
+    device_destroy(globalfifo_class, MKDEV(globalfifo_major, index));
+    cdev_del(&dev->cdev);
+    for_each_possible_cpu(cpu)
+        vfree(per_cpu_ptr(dev->shards, cpu)->mem);
+    for (prio = 1; prio <= FIFO_PRIO_MAX; prio++)
+        vfree(globalfifo_lane(dev, prio)->ring.mem);
+    kfree(dev->stamps);
+    free_percpu(dev->shards);
+    percpu_free_rwsem(&dev->mode_sem);
+    vfree(dev->mem);
+    vfree(dev->ctrl);
 }
 
 static int __init globalfifo_init(void)
 {
-    int ret;
+    int ret, i;
     dev_t devno = MKDEV(globalfifo_major, 0);
 
+    if (globalfifo_size == 0 || globalfifo_size > GLOBALFIFO_SIZE_MAX ||
+        globalfifo_lane_size == 0 || globalfifo_lane_size > GLOBALFIFO_SIZE_MAX ||
+        globalfifo_num == 0 || globalfifo_num > GLOBALFIFO_NUM_MAX)
+        return -EINVAL;
+
     if (globalfifo_major)
-        ret = register_chrdev_region(devno, 1, "globalfifo");
+        ret = register_chrdev_region(devno, globalfifo_num, "globalfifo");
     else {
-        ret = alloc_chrdev_region(&devno, 0, 1, "globalfifo");
+        ret = alloc_chrdev_region(&devno, 0, globalfifo_num, "globalfifo");
         globalfifo_major = MAJOR(devno);
     }
     if (ret < 0)
         return ret;
 
-    globalfifo_devp = kzalloc(sizeof(struct globalfifo_dev), GFP_KERNEL);
+    globalfifo_devp = kcalloc(globalfifo_num, sizeof(struct globalfifo_dev), GFP_KERNEL);
     if (!globalfifo_devp) {
         ret = -ENOMEM;
         goto fail_malloc;
     }
 
-    globalfifo_setup_cdev(globalfifo_devp, 0);
+    // Creating struct class under /sys/class/globalfifo, devices get sysfs attributes.
+    globalfifo_class = class_create(THIS_MODULE, "globalfifo");
+    if (IS_ERR(globalfifo_class)) {
+        ret = PTR_ERR(globalfifo_class);
+        goto fail_class;
+    }
+    globalfifo_class->dev_groups = globalfifo_groups;
+    globalfifo_class->devnode = globalfifo_devnode;
 
-    mutex_init(&globalfifo_devp->mutex);
-    init_waitqueue_head(&globalfifo_devp->r_wait);
-    init_waitqueue_head(&globalfifo_devp->w_wait);
+    for (i = 0; i < globalfifo_num; i++) {
+        ret = globalfifo_setup_dev(globalfifo_devp + i, i);
+        if (ret)
+            goto fail_dev;
+    }
 
     return 0;
 
+fail_dev:
+    while (--i >= 0)
+        globalfifo_remove_dev(globalfifo_devp + i, i);
+    class_destroy(globalfifo_class);
+fail_class:
+    kfree(globalfifo_devp);
 fail_malloc:
-    unregister_chrdev_region(devno, 1);
+    unregister_chrdev_region(devno, globalfifo_num);
     return ret;
 }
 module_init(globalfifo_init);
 
 static void __exit globalfifo_exit(void)
 {
-    cdev_del(&globalfifo_devp->cdev);
+    int i;
+
+    for (i = 0; i < globalfifo_num; i++)
+        globalfifo_remove_dev(globalfifo_devp + i, i);
+    class_destroy(globalfifo_class);
     kfree(globalfifo_devp);
-    unregister_chrdev_region(MKDEV(globalfifo_major, 0), 1);
+    unregister_chrdev_region(MKDEV(globalfifo_major, 0), globalfifo_num);
 }
 module_exit(globalfifo_exit);
 
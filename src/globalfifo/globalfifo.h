@@ -0,0 +1,161 @@
+/*
+ * ioctl commands and mmap ring layout of globalfifo device shared by kernel module and user space application.
+ */
+
+#ifndef GLOBALFIFO_H
+#define GLOBALFIFO_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define GLOBALFIFO_MAGIC 'f'
+
+// Discard all data in FIFO (plain number kept for existing applications).
+#define FIFO_CLEAR 0x1
+// Wake up readers / writers sleeping on the ring after head / tail is advanced via mmap.
+#define FIFO_NOTIFY _IO(GLOBALFIFO_MAGIC, 0x02)
+// Resize ring (bytes, rounded up to power of two), buffered data is kept. -EBUSY if it doesn't fit or ring is mapped.
+#define FIFO_SET_SIZE _IOW(GLOBALFIFO_MAGIC, 0x03, __u32)
+// Get current ring capacity (bytes).
+#define FIFO_GET_SIZE _IOR(GLOBALFIFO_MAGIC, 0x04, __u32)
+// Set FIFO_MODE_xxx flags, ring must be empty (-EBUSY otherwise).
+#define FIFO_SET_MODE _IOW(GLOBALFIFO_MAGIC, 0x05, __u32)
+#define FIFO_GET_MODE _IOR(GLOBALFIFO_MAGIC, 0x06, __u32)
+
+/*
+ * Record mode: each write() is one record, stored in ring as __u32 length (native byte order)
+ * followed by payload without padding. read() returns payload of exactly one record, -EMSGSIZE
+ * if it doesn't fit the buffer (record is kept). Records larger than ring capacity are rejected
+ * with -EMSGSIZE.
+ */
+#define FIFO_MODE_RECORD 0x1
+// With FIFO_MODE_RECORD, read() returns as many whole records as fit, each with its length header.
+#define FIFO_MODE_BATCH 0x2
+/*
+ * Broadcast mode: every reader has its own cursor and sees all data written after the oldest data
+ * buffered when it started. A read-only open is a reader from open on, a read / write open only from
+ * its first read(), so a producer opened O_RDWR doesn't hold back writers. Writer blocks on the slowest
+ * reader by default. The mmap consumer is not supported in broadcast mode.
+ */
+#define FIFO_MODE_BROADCAST 0x4
+/*
+ * Overwrite-oldest (lossy) mode: writer never blocks on readers but drops oldest data (whole records in
+ * record mode) to make room, with FIFO_MODE_BROADCAST even data some readers have already read. Data lost
+ * before a reader read it is counted per reader (FIFO_GET_DROPPED). Not combined with per-CPU mode, the
+ * mmap consumer is not supported.
+ */
+#define FIFO_MODE_OVERWRITE 0x8
+/*
+ * Per-CPU mode: each CPU has its own ring (capacity of the FIFO when the mode is set), a write() appends one
+ * record to the ring of the writer's CPU, so writers on different CPUs never contend. read() drains all CPU
+ * rings with record semantics (FIFO_MODE_BATCH applies), round-robin over CPUs. Not combined with broadcast.
+ * Watermarks, high_water and mmap cover the shared ring only.
+ */
+#define FIFO_MODE_PERCPU 0x10
+/*
+ * With FIFO_MODE_PERCPU, records are numbered at write and read() returns them in that order. Best-effort:
+ * a record still being copied in on another CPU is not waited for. Writers share one counter again.
+ */
+#define FIFO_MODE_ORDERED 0x20
+/*
+ * With FIFO_MODE_RECORD or FIFO_MODE_PERCPU, read() prefixes every record by its __u64 write time
+ * (CLOCK_MONOTONIC ns, 0 if unknown), before the length header in batch mode. Writes to the FIFO ring
+ * are timed in a side table of the kernel, so records written while many (> 1024) writes are buffered, or
+ * by an mmap producer, have no time.
+ */
+#define FIFO_MODE_TIMESTAMP 0x40
+
+#define FIFO_RECORD_HDR_SIZE 4
+#define FIFO_STAMP_SIZE 8
+
+/*
+ * Watermarks (bytes, 0 behaves as 1, clamped to ring capacity), like SO_RCVLOWAT / SO_SNDLOWAT:
+ * - read: blocking read() / poll() report readable once at least read bytes are buffered, a write
+ *   wakes readers and sends SIGIO only then.
+ * - write: blocking write() / poll() report writable once at least write bytes are free, a read
+ *   wakes writers only then.
+ */
+struct fifo_lowat {
+    __u32 read;
+    __u32 write;
+};
+
+#define FIFO_SET_LOWAT _IOW(GLOBALFIFO_MAGIC, 0x07, struct fifo_lowat)
+#define FIFO_GET_LOWAT _IOR(GLOBALFIFO_MAGIC, 0x08, struct fifo_lowat)
+
+/*
+ * Attach eventfd (__s32 fd, -1 detaches) to this open file. It is signaled when FIFO becomes readable
+ * (buffered bytes reach read watermark) or writable (free bytes reach write watermark), and on FIFO_NOTIFY.
+ * Signals are edge-triggered: drain FIFO (read / write until EAGAIN) after each event.
+ * poll() / epoll waiters are woken on the same transitions only, once the FIFO was seen not ready
+ * (by poll, a read / write returning EAGAIN or blocking) since the previous one. EPOLLET gets one event each.
+ */
+#define FIFO_SET_EVENTFD _IOW(GLOBALFIFO_MAGIC, 0x09, __s32)
+
+/*
+ * Priority lanes: writes through a file set to priority p > 0 (FIFO_SET_PRIO, __u32) go to lane p as one
+ * record, instead of the FIFO ring (lane 0).
+ * read() serves the highest non-empty lane first, one record payload (FIFO_MODE_BATCH: whole records of
+ * that lane with length headers) in any mode, bypassing the read watermark. Lanes hold globalfifo_lane_size
+ * bytes each, they are not available in broadcast mode (-EINVAL).
+ */
+#define FIFO_PRIO_NUM 4
+#define FIFO_PRIO_MAX (FIFO_PRIO_NUM - 1)
+
+#define FIFO_SET_PRIO _IOW(GLOBALFIFO_MAGIC, 0x0a, __u32)
+#define FIFO_GET_PRIO _IOR(GLOBALFIFO_MAGIC, 0x0b, __u32)
+
+/*
+ * Weighted dequeue: lane p is served at most weight[p] reads in a row while lower lanes have data, then
+ * one read goes to the next lower lane. 0 (default) is strict priority, weight[0] is unused.
+ */
+struct fifo_prio_weights {
+    __u32 weight[FIFO_PRIO_NUM];
+};
+
+#define FIFO_SET_WEIGHTS _IOW(GLOBALFIFO_MAGIC, 0x0c, struct fifo_prio_weights)
+#define FIFO_GET_WEIGHTS _IOR(GLOBALFIFO_MAGIC, 0x0d, struct fifo_prio_weights)
+
+/*
+ * Write semantics of an open file (FIFO_SET_WRITE_FLAGS, __u32) for the byte stream ring, by default a
+ * write() stores as many bytes as are free and returns the short count. Record writes are always whole.
+ */
+// All or nothing: wait until the whole write fits (-EAGAIN if non-blocking), -EMSGSIZE above ring capacity.
+#define FIFO_WRITE_ATOMIC 0x1
+/*
+ * Blocking write() returns only once all bytes are stored, sleeping for space in between (the byte count
+ * written so far if interrupted by a signal). Writes of other writers may be interleaved between chunks.
+ */
+#define FIFO_WRITE_ALL 0x2
+
+#define FIFO_SET_WRITE_FLAGS _IOW(GLOBALFIFO_MAGIC, 0x0e, __u32)
+#define FIFO_GET_WRITE_FLAGS _IOR(GLOBALFIFO_MAGIC, 0x0f, __u32)
+
+// Data dropped by FIFO_MODE_OVERWRITE before this reader read it, since open (records: record mode only).
+struct fifo_dropped {
+    __u64 bytes;
+    __u64 records;
+};
+
+#define FIFO_GET_DROPPED _IOR(GLOBALFIFO_MAGIC, 0x10, struct fifo_dropped)
+
+/*
+ * mmap layout: control page at offset 0, data ring at ctrl->data_offset, mapped separately.
+ * Indices are free running, used length = head - tail, byte of index i is data[i & (size - 1)].
+ * - Producer: write data, store head with release order, then FIFO_NOTIFY if reader_waiting is set.
+ * - Consumer: load head with acquire order, read data, store tail with release order, then
+ *   FIFO_NOTIFY if writer_waiting is set.
+ * One producer and one consumer at a time, mmap and read() / write() of the same side must not be mixed.
+ */
+struct globalfifo_ctrl {
+    __u32 head;           // Producer index.
+    __u32 __pad0[15];     // Keep head and tail on separate cache lines.
+    __u32 tail;           // Consumer index.
+    __u32 __pad1[15];
+    __u32 size;           // Data ring bytes, power of two (read only).
+    __u32 data_offset;    // mmap offset of data ring (read only).
+    __u32 reader_waiting; // Set by kernel when a reader sleeps on empty ring.
+    __u32 writer_waiting; // Set by kernel when a writer sleeps on full ring.
+};
+
+#endif
@@ -21,7 +21,7 @@ int main(void)
 	int oflags;
     int fd;
 
-    if ((fd = ::open("/dev/globalfifo", O_RDWR, S_IRUSR | S_IWUSR)) == -1)
+    if ((fd = ::open("/dev/globalfifo0", O_RDWR, S_IRUSR | S_IWUSR)) == -1)
     {
         return EXIT_FAILURE;
     }
@@ -0,0 +1,101 @@
+/**
+ * @file main_bench.cpp
+ * @brief Benchmark globalfifo throughput with one producer and one consumer thread.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_bench [device], chunk sizes 1 B, 64 B and 4 KiB are measured in turn.
+ */
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define CHUNK_COUNT 1000000          // Chunks transferred per chunk size.
+#define MAX_TOTAL_BYTES (256UL << 20) // Cap of bytes transferred per chunk size.
+
+using Clock = std::chrono::steady_clock;
+
+static bool producer(const char *dev, size_t chunk, size_t total)
+{
+    std::vector<char> buf(chunk, 'p');
+    int fd = ::open(dev, O_WRONLY);
+
+    if (fd == -1)
+    {
+        std::perror("open");
+        return false;
+    }
+    for (size_t done = 0; done < total;)
+    {
+        ssize_t ret = ::write(fd, buf.data(), std::min(chunk, total - done));
+        if (ret < 0)
+        {
+            std::perror("write");
+            ::close(fd);
+            return false;
+        }
+        done += ret;
+    }
+    ::close(fd);
+    return true;
+}
+
+static bool bench(const char *dev, size_t chunk)
+{
+    size_t total = std::min(chunk * CHUNK_COUNT, MAX_TOTAL_BYTES);
+    std::vector<char> buf(chunk);
+    bool writeOk = true;
+    int fd;
+
+    auto begin = Clock::now();
+    std::thread writer([&] { writeOk = producer(dev, chunk, total); });
+    if ((fd = ::open(dev, O_RDONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        writer.detach();
+        return false;
+    }
+    // Consumer, partial reads are counted by bytes.
+    for (size_t done = 0; done < total;)
+    {
+        ssize_t ret = ::read(fd, buf.data(), std::min(chunk, total - done));
+        if (ret < 0)
+        {
+            std::perror("read");
+            // Unblock producer waiting on full FIFO is not possible, leave it to process exit.
+            writer.detach();
+            ::close(fd);
+            return false;
+        }
+        done += ret;
+    }
+    writer.join();
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    ::close(fd);
+
+    std::cout << "chunk " << chunk << " B: " << total << " bytes in " << sec << " s, "
+              << (uint64_t)(total / sec / (1 << 20)) << " MiB/s, " << (uint64_t)(total / chunk / sec) << " ops/s\n";
+    return writeOk;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+
+    for (size_t chunk : {1UL, 64UL, 4096UL})
+    {
+        if (!bench(dev, chunk))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file main_broadcast.cpp
+ * @brief Check globalfifo broadcast mode: every reader gets all data, an O_RDWR producer doesn't block writers.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_broadcast [device]
+ * Two read-only readers must both receive every message. A producer opened O_RDWR that never reads fills
+ * the FIFO, the readers drain it, then the producer must be able to write again (block-slowest mode
+ * waits on the slowest reader, which must not be the producer itself).
+ */
+#include <iostream>
+#include <vector>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "globalfifo.h"
+
+#define MSG "broadcast"
+
+// Read until EAGAIN, return bytes read or -1.
+static ssize_t drain(int fd, std::vector<char> &buf)
+{
+    ssize_t total = 0, ret;
+
+    while ((ret = ::read(fd, buf.data(), buf.size())) > 0)
+    {
+        total += ret;
+    }
+    if (ret < 0 && errno != EAGAIN)
+    {
+        std::perror("read");
+        return -1;
+    }
+    return total;
+}
+
+static bool checkFanout(int wfd, int rfd1, int rfd2)
+{
+    char buf1[64] = {}, buf2[64] = {};
+
+    if (::write(wfd, MSG, sizeof(MSG)) != sizeof(MSG))
+    {
+        std::perror("write");
+        return false;
+    }
+    bool ok = ::read(rfd1, buf1, sizeof(buf1)) == sizeof(MSG) && ::read(rfd2, buf2, sizeof(buf2)) == sizeof(MSG) &&
+              ::strcmp(buf1, MSG) == 0 && ::strcmp(buf2, MSG) == 0;
+
+    std::cout << "every reader gets all data: " << (ok ? "ok" : "FAILED") << "\n";
+    return ok;
+}
+
+static bool checkRdwrProducer(const char *dev, int rfd1, int rfd2, __u32 size)
+{
+    std::vector<char> buf(size, 'p');
+    ssize_t written = 0, ret;
+    int wfd = ::open(dev, O_RDWR | O_NONBLOCK);
+
+    if (wfd < 0)
+    {
+        std::perror("open");
+        return false;
+    }
+    while ((ret = ::write(wfd, buf.data(), buf.size())) > 0)
+    {
+        written += ret;
+    }
+    bool ok = written == (ssize_t)size && drain(rfd1, buf) == written && drain(rfd2, buf) == written;
+
+    // Both readers are done, the space is free although the producer never read.
+    ok = ok && ::write(wfd, MSG, sizeof(MSG)) == sizeof(MSG);
+    ok = ok && drain(rfd1, buf) == sizeof(MSG) && drain(rfd2, buf) == sizeof(MSG);
+    ::close(wfd);
+
+    std::cout << "O_RDWR producer doesn't block writers: " << (ok ? "ok" : "FAILED, FIFO stays full") << "\n";
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    __u32 mode = FIFO_MODE_BROADCAST;
+    __u32 size;
+    int rfd1, rfd2, wfd;
+
+    if ((rfd1 = ::open(dev, O_RDONLY | O_NONBLOCK)) == -1 || (rfd2 = ::open(dev, O_RDONLY | O_NONBLOCK)) == -1 ||
+        (wfd = ::open(dev, O_WRONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        return EXIT_FAILURE;
+    }
+    if (::ioctl(rfd1, FIFO_CLEAR, 0) < 0 || ::ioctl(rfd1, FIFO_SET_MODE, &mode) < 0 ||
+        ::ioctl(rfd1, FIFO_GET_SIZE, &size) < 0)
+    {
+        std::perror("FIFO_SET_MODE");
+        return EXIT_FAILURE;
+    }
+
+    bool ok = checkFanout(wfd, rfd1, rfd2) && checkRdwrProducer(dev, rfd1, rfd2, size);
+
+    // Back to byte stream for other applications.
+    mode = 0;
+    ::ioctl(rfd1, FIFO_CLEAR, 0);
+    ::ioctl(rfd1, FIFO_SET_MODE, &mode);
+    ::close(wfd);
+    ::close(rfd2);
+    ::close(rfd1);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file main_epoll.cpp
+ * @brief Measure epoll_wait wakeups and CPU usage with many idle globalfifo devices and one busy one.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_epoll [device prefix] [fifos], e.g. ./main_epoll /dev/globalfifo 1000
+ * (insmod ./globalfifo.ko globalfifo_num=1000). All FIFOs are registered for EPOLLIN, level-triggered and
+ * then edge-triggered (EPOLLET). First all of them stay idle, then a writer sends bursts of 64-byte messages
+ * to the first one, the reader drains a FIFO until EAGAIN on each event.
+ */
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#define MSG_SIZE 64
+#define BURST 16
+#define PHASE std::chrono::seconds(2)
+#define MAX_EVENTS 64
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<bool> stopWriter(false);
+
+struct Stats
+{
+    uint64_t wakeups = 0;
+    uint64_t events = 0;
+    uint64_t bytes = 0;
+    double cpu = 0; // CPU time of the reader thread (s).
+};
+
+static double threadCpu()
+{
+    rusage ru;
+    ::getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void writerThread(const char *dev)
+{
+    char msg[MSG_SIZE];
+    int fd = ::open(dev, O_WRONLY);
+
+    ::memset(msg, 'w', sizeof(msg));
+    while (fd >= 0 && !stopWriter)
+    {
+        for (int i = 0; i < BURST; i++)
+        {
+            if (::write(fd, msg, sizeof(msg)) < 0)
+            {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    ::close(fd);
+}
+
+// Wait for events for one phase, draining every reported FIFO.
+static Stats runPhase(int epfd)
+{
+    epoll_event events[MAX_EVENTS];
+    char buf[4096];
+    Stats stats;
+    double cpu = threadCpu();
+    auto end = Clock::now() + PHASE;
+
+    while (Clock::now() < end)
+    {
+        int n = ::epoll_wait(epfd, events, MAX_EVENTS, 100);
+        if (n <= 0)
+        {
+            continue;
+        }
+        stats.wakeups++;
+        stats.events += n;
+        for (int i = 0; i < n; i++)
+        {
+            ssize_t ret;
+            while ((ret = ::read(events[i].data.fd, buf, sizeof(buf))) > 0)
+            {
+                stats.bytes += ret;
+            }
+        }
+    }
+    stats.cpu = threadCpu() - cpu;
+    return stats;
+}
+
+static void report(const char *name, const char *phase, const Stats &stats)
+{
+    double sec = std::chrono::duration<double>(PHASE).count();
+
+    std::cout << name << ", " << phase << ": " << (uint64_t)(stats.wakeups / sec) << " wakeups/s, "
+              << (uint64_t)(stats.events / sec) << " events/s, "
+              << (stats.wakeups ? stats.bytes / stats.wakeups : 0) << " bytes per wakeup, CPU "
+              << stats.cpu / sec * 100 << "%\n";
+}
+
+static bool bench(const std::vector<int> &fds, const char *dev, const char *name, uint32_t events)
+{
+    int epfd = ::epoll_create1(0);
+
+    if (epfd < 0)
+    {
+        std::perror("epoll_create1");
+        return false;
+    }
+    for (int fd : fds)
+    {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            std::perror("epoll_ctl");
+            ::close(epfd);
+            return false;
+        }
+    }
+
+    report(name, "idle", runPhase(epfd));
+
+    stopWriter = false;
+    std::thread writer(writerThread, dev);
+    report(name, "1 busy", runPhase(epfd));
+    stopWriter = true;
+    writer.join();
+
+    ::close(epfd);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string prefix = argc > 1 ? argv[1] : "/dev/globalfifo";
+    int num = argc > 2 ? std::atoi(argv[2]) : 1000;
+    std::vector<int> fds;
+    char buf[4096];
+
+    for (int i = 0; i < num; i++)
+    {
+        int fd = ::open((prefix + std::to_string(i)).c_str(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0)
+        {
+            std::cout << "Device open failure: " << prefix << i << "\n";
+            return EXIT_FAILURE;
+        }
+        // Start from empty FIFOs.
+        while (::read(fd, buf, sizeof(buf)) > 0)
+        {
+        }
+        fds.push_back(fd);
+    }
+    std::cout << num << " FIFOs\n";
+
+    std::string busy = prefix + "0";
+    if (!bench(fds, busy.c_str(), "level-triggered", EPOLLIN) ||
+        !bench(fds, busy.c_str(), "edge-triggered", EPOLLIN | EPOLLET))
+    {
+        return EXIT_FAILURE;
+    }
+
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    return EXIT_SUCCESS;
+}
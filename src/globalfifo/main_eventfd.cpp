@@ -0,0 +1,79 @@
+/**
+ * @file main_eventfd.cpp
+ * @brief Multiplex several globalfifo devices with one epoll instance via attached eventfds.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_eventfd /dev/globalfifo0 [/dev/globalfifo1 ...]
+ * Echo data into any FIFO, e.g. echo hello > /dev/globalfifo1, it is read out when its eventfd fires.
+ */
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+
+#include "globalfifo.h"
+
+#define MAX_LEN 100
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> fds;
+    int epfd = ::epoll_create1(0);
+
+    if (argc < 2 || epfd < 0)
+    {
+        std::cout << "Usage: " << argv[0] << " <device>...\n";
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        int fd = ::open(argv[i], O_RDONLY | O_NONBLOCK);
+        int efd = ::eventfd(0, EFD_NONBLOCK);
+        epoll_event ev = {};
+
+        // Attach eventfd to FIFO, eventfd is watched instead of the device.
+        if (fd < 0 || efd < 0 || ::ioctl(fd, FIFO_SET_EVENTFD, &efd) < 0)
+        {
+            std::perror(argv[i]);
+            return EXIT_FAILURE;
+        }
+        ev.events = EPOLLIN;
+        ev.data.u32 = fds.size();
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &ev);
+        fds.push_back(fd);
+        fds.push_back(efd);
+    }
+
+    while (1)
+    {
+        epoll_event events[16];
+        int n = ::epoll_wait(epfd, events, 16, -1);
+
+        for (int i = 0; i < n; i++)
+        {
+            int fd = fds[events[i].data.u32];
+            int efd = fds[events[i].data.u32 + 1];
+            char buf[MAX_LEN];
+            uint64_t count;
+            ssize_t len;
+
+            // Reset eventfd counter, then drain FIFO as events are edge-triggered.
+            ::read(efd, &count, sizeof(count));
+            while ((len = ::read(fd, buf, sizeof(buf) - 1)) > 0)
+            {
+                buf[len] = '\0';
+                std::cout << argv[events[i].data.u32 / 2 + 1] << ": " << buf;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
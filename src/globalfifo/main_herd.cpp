@@ -0,0 +1,108 @@
+/**
+ * @file main_herd.cpp
+ * @brief Measure context switches per message with many readers blocked on one globalfifo.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_herd [device] [readers], e.g. ./main_herd /dev/globalfifo0 64
+ * Writer sends one 64-byte message at a time and waits until a reader took it, so every message
+ * meets all readers blocked. With wake-all every reader wakes up for each message (thundering herd),
+ * with exclusive wakeups only one does. Run against the old and new module to compare.
+ */
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define MSG_SIZE 64
+#define MSG_COUNT 20000
+#define READERS 64
+
+static std::atomic<long> received(0);
+
+static void readerThread(const char *dev)
+{
+    char buf[MSG_SIZE];
+    int fd = ::open(dev, O_RDONLY);
+
+    while (fd >= 0 && ::read(fd, buf, sizeof(buf)) == sizeof(buf))
+    {
+        // Stop message tells reader to exit.
+        if (buf[0] == 's')
+        {
+            break;
+        }
+        received++;
+    }
+    ::close(fd);
+}
+
+// Context switches of the whole process (all threads).
+static long contextSwitches()
+{
+    rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    int readers = argc > 2 ? std::atoi(argv[2]) : READERS;
+    std::vector<std::thread> threads;
+    char msg[MSG_SIZE];
+    int fd;
+
+    for (int i = 0; i < readers; i++)
+    {
+        threads.emplace_back(readerThread, dev);
+    }
+    if ((fd = ::open(dev, O_WRONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        ::exit(EXIT_FAILURE);
+    }
+    // Let all readers block on empty FIFO.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    ::memset(msg, 'm', sizeof(msg));
+    long switches = contextSwitches();
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < MSG_COUNT; i++)
+    {
+        if (::write(fd, msg, sizeof(msg)) != sizeof(msg))
+        {
+            std::perror("write");
+            ::exit(EXIT_FAILURE);
+        }
+        // Busy wait (no context switch) until a reader got it, readers are all blocked again.
+        while (received.load() <= i)
+        {
+        }
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    switches = contextSwitches() - switches;
+
+    std::cout << readers << " blocked readers: " << MSG_COUNT << " messages, " << (double)switches / MSG_COUNT
+              << " context switches / message, " << (uint64_t)(MSG_COUNT / sec) << " messages/s\n";
+
+    ::memset(msg, 's', sizeof(msg));
+    for (int i = 0; i < readers; i++)
+    {
+        ::write(fd, msg, sizeof(msg));
+    }
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+    ::close(fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file main_latency.cpp
+ * @brief Read write times of globalfifo records (FIFO_MODE_TIMESTAMP) and print the queueing latency histogram.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_latency [device] [sysfs directory], e.g.
+ * ./main_latency /dev/globalfifo0 /sys/class/globalfifo/globalfifo0
+ * A writer sends bursts of 64-byte records, the reader sleeps between batch reads so that data queues up.
+ * Latency seen by the reader from returned write times is compared with the in-kernel histogram.
+ */
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "globalfifo.h"
+
+#define MSG_SIZE 64
+#define MSG_COUNT 20000
+#define BURST 16
+
+// Same clock as ktime_get_ns() of the kernel.
+static uint64_t monotonicNs()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void writerThread(const char *dev)
+{
+    char msg[MSG_SIZE];
+    int fd = ::open(dev, O_WRONLY);
+
+    ::memset(msg, 'w', sizeof(msg));
+    for (int i = 0; fd >= 0 && i < MSG_COUNT; i++)
+    {
+        if (::write(fd, msg, sizeof(msg)) < 0)
+        {
+            break;
+        }
+        if (i % BURST == BURST - 1)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    std::string sysfs = argc > 2 ? argv[2] : "/sys/class/globalfifo/globalfifo0";
+    __u32 mode = FIFO_MODE_RECORD | FIFO_MODE_BATCH | FIFO_MODE_TIMESTAMP;
+    std::vector<char> buf(64 << 10);
+    std::vector<double> lat;
+    size_t records = 0, unstamped = 0;
+    int fd;
+
+    if ((fd = ::open(dev, O_RDONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        return EXIT_FAILURE;
+    }
+    if (::ioctl(fd, FIFO_CLEAR, 0) < 0 || ::ioctl(fd, FIFO_SET_MODE, &mode) < 0)
+    {
+        std::perror("FIFO_SET_MODE");
+        return EXIT_FAILURE;
+    }
+    // Start from an empty histogram.
+    std::ofstream(sysfs + "/latency_hist") << "0\n";
+
+    std::thread writer(writerThread, dev);
+    while (records < MSG_COUNT)
+    {
+        ssize_t ret = ::read(fd, buf.data(), buf.size());
+        if (ret < 0)
+        {
+            std::perror("read");
+            writer.detach();
+            return EXIT_FAILURE;
+        }
+        uint64_t now = monotonicNs();
+        // Each record: __u64 write time, __u32 length, payload.
+        for (ssize_t pos = 0; pos + FIFO_STAMP_SIZE + FIFO_RECORD_HDR_SIZE <= ret;)
+        {
+            uint64_t stamp;
+            __u32 len;
+            ::memcpy(&stamp, &buf[pos], sizeof(stamp));
+            ::memcpy(&len, &buf[pos + FIFO_STAMP_SIZE], sizeof(len));
+            // Records written while the kernel stamp table was full have no time.
+            if (stamp != 0)
+            {
+                lat.push_back((now - stamp) / 1000.0);
+            }
+            else
+            {
+                unstamped++;
+            }
+            records++;
+            pos += FIFO_STAMP_SIZE + FIFO_RECORD_HDR_SIZE + len;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    writer.join();
+
+    std::cout << "reader: " << records << " records, " << unstamped << " without write time\n";
+    if (!lat.empty())
+    {
+        std::sort(lat.begin(), lat.end());
+        std::cout << "latency p50 " << lat[lat.size() / 2] << " us, p99 " << lat[lat.size() * 99 / 100]
+                  << " us, max " << lat.back() << " us\n";
+    }
+
+    std::ifstream hist(sysfs + "/latency_hist");
+    std::cout << "kernel histogram (from ns, reads):\n" << hist.rdbuf();
+
+    mode = 0;
+    ::ioctl(fd, FIFO_SET_MODE, &mode);
+    ::close(fd);
+    return EXIT_SUCCESS;
+}
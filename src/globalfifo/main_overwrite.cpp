@@ -0,0 +1,106 @@
+/**
+ * @file main_overwrite.cpp
+ * @brief Telemetry stream through globalfifo in overwrite-oldest mode: producer never stalls on a slow reader.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_overwrite [device]
+ * A writer sends numbered 64-byte samples as fast as it can (FIFO_MODE_RECORD | FIFO_MODE_OVERWRITE),
+ * the reader sleeps between reads. Samples missing in the sequence are compared with FIFO_GET_DROPPED.
+ */
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "globalfifo.h"
+
+#define MSG_SIZE 64
+#define MSG_COUNT 1000000
+
+using Clock = std::chrono::steady_clock;
+
+static void writerThread(const char *dev, double *sec)
+{
+    char msg[MSG_SIZE] = {};
+    int fd = ::open(dev, O_WRONLY);
+    auto begin = Clock::now();
+
+    for (uint64_t seq = 1; fd >= 0 && seq <= MSG_COUNT; seq++)
+    {
+        ::memcpy(msg, &seq, sizeof(seq));
+        if (::write(fd, msg, sizeof(msg)) != sizeof(msg))
+        {
+            std::perror("write");
+            break;
+        }
+    }
+    *sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    __u32 mode = FIFO_MODE_RECORD | FIFO_MODE_OVERWRITE;
+    fifo_dropped dropped = {};
+    uint64_t seq = 0, received = 0, missing = 0;
+    char msg[MSG_SIZE];
+    double sec = 0;
+    int fd;
+
+    if ((fd = ::open(dev, O_RDONLY | O_NONBLOCK)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        return EXIT_FAILURE;
+    }
+    if (::ioctl(fd, FIFO_CLEAR, 0) < 0 || ::ioctl(fd, FIFO_SET_MODE, &mode) < 0)
+    {
+        std::perror("FIFO_SET_MODE");
+        return EXIT_FAILURE;
+    }
+
+    std::thread writer(writerThread, dev, &sec);
+    while (seq < MSG_COUNT)
+    {
+        ssize_t ret = ::read(fd, msg, sizeof(msg));
+        if (ret < 0)
+        {
+            if (errno != EAGAIN)
+            {
+                std::perror("read");
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        uint64_t next;
+        ::memcpy(&next, msg, sizeof(next));
+        missing += next - seq - 1;
+        seq = next;
+        received++;
+        // Slow consumer.
+        std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+    writer.join();
+
+    if (::ioctl(fd, FIFO_GET_DROPPED, &dropped) < 0)
+    {
+        std::perror("FIFO_GET_DROPPED");
+        return EXIT_FAILURE;
+    }
+    std::cout << "writer: " << (uint64_t)(MSG_COUNT / sec) << " msgs/s, reader: " << received << " received, "
+              << missing << " missing in sequence\n"
+              << "FIFO_GET_DROPPED: " << dropped.records << " records, " << dropped.bytes << " bytes\n";
+
+    mode = 0;
+    ::ioctl(fd, FIFO_SET_MODE, &mode);
+    ::close(fd);
+    return EXIT_SUCCESS;
+}
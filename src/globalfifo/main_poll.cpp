@@ -11,7 +11,7 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 
-#define FIFO_CLEAR 0x01
+#include "globalfifo.h"
 
 int main()
 {
@@ -22,7 +22,7 @@ int main()
     struct timeval timeout;
 
     // Open device file with non-block mode.
-    if ((fd = ::open("/dev/globalfifo", O_RDONLY | O_NONBLOCK)) == -1)
+    if ((fd = ::open("/dev/globalfifo0", O_RDONLY | O_NONBLOCK)) == -1)
     {
         std::cout << "Device open failure\n";
         return EXIT_FAILURE;
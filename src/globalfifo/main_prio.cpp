@@ -0,0 +1,164 @@
+/**
+ * @file main_prio.cpp
+ * @brief Measure latency of small control messages through globalfifo under bulk load, with and without priority lanes.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_prio [device]
+ * A bulk writer keeps the FIFO full of 4000-byte records, a control writer sends a timestamped 16-byte
+ * record every 200 us through the same ring, or through lane 1 or FIFO_PRIO_MAX (FIFO_SET_PRIO).
+ * One reader takes one record per read() and reports control message latency.
+ */
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "globalfifo.h"
+
+#define BULK_SIZE 4000
+#define CTRL_COUNT 2000
+#define CTRL_INTERVAL std::chrono::microseconds(200)
+
+using Clock = std::chrono::steady_clock;
+
+enum CtrlPath
+{
+    CTRL_RING,
+    CTRL_LANE,
+    CTRL_LANE_MAX,
+};
+
+static std::atomic<bool> stopBulk(false);
+static std::atomic<bool> bulkDone(false);
+
+static uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static void bulkThread(const char *dev)
+{
+    std::vector<char> buf(BULK_SIZE, 'B');
+    int fd = ::open(dev, O_WRONLY);
+
+    while (fd >= 0 && !stopBulk)
+    {
+        if (::write(fd, buf.data(), buf.size()) < 0)
+        {
+            break;
+        }
+    }
+    ::close(fd);
+    bulkDone = true;
+}
+
+static void ctrlThread(const char *dev, CtrlPath path)
+{
+    char msg[16] = {'C'};
+    __u32 prio = path == CTRL_LANE_MAX ? FIFO_PRIO_MAX : 1;
+    int fd = ::open(dev, O_WRONLY);
+
+    if (fd >= 0 && path != CTRL_RING && ::ioctl(fd, FIFO_SET_PRIO, &prio) < 0)
+    {
+        std::perror("FIFO_SET_PRIO");
+    }
+    for (int i = 0; fd >= 0 && i < CTRL_COUNT; i++)
+    {
+        std::this_thread::sleep_for(CTRL_INTERVAL);
+        uint64_t stamp = nowNs();
+        ::memcpy(msg + 8, &stamp, sizeof(stamp));
+        if (::write(fd, msg, sizeof(msg)) < 0)
+        {
+            std::perror("write");
+            break;
+        }
+    }
+    ::close(fd);
+}
+
+static bool bench(const char *dev, int fd, const char *name, CtrlPath path)
+{
+    std::vector<char> buf(BULK_SIZE);
+    std::vector<double> lat;
+    __u32 mode = FIFO_MODE_RECORD;
+
+    if (::ioctl(fd, FIFO_CLEAR, 0) < 0 || ::ioctl(fd, FIFO_SET_MODE, &mode) < 0)
+    {
+        std::perror("FIFO_SET_MODE");
+        return false;
+    }
+
+    stopBulk = false;
+    bulkDone = false;
+    std::thread bulk(bulkThread, dev);
+    std::thread ctrl(ctrlThread, dev, path);
+
+    while (lat.size() < CTRL_COUNT)
+    {
+        ssize_t ret = ::read(fd, buf.data(), buf.size());
+        if (ret < 0)
+        {
+            std::perror("read");
+            break;
+        }
+        if (ret == 16 && buf[0] == 'C')
+        {
+            uint64_t stamp;
+            ::memcpy(&stamp, buf.data() + 8, sizeof(stamp));
+            lat.push_back((nowNs() - stamp) / 1000.0);
+        }
+    }
+
+    // Bulk writer may sleep on a full FIFO, discard data until it has seen the stop flag.
+    stopBulk = true;
+    while (!bulkDone)
+    {
+        ::ioctl(fd, FIFO_CLEAR, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bulk.join();
+    ctrl.join();
+
+    if (lat.size() < CTRL_COUNT)
+    {
+        return false;
+    }
+    std::sort(lat.begin(), lat.end());
+    std::cout << name << ": control latency p50 " << lat[lat.size() / 2] << " us, p99 "
+              << lat[lat.size() * 99 / 100] << " us, max " << lat.back() << " us\n";
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    __u32 mode = 0;
+    int fd;
+
+    if ((fd = ::open(dev, O_RDONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!bench(dev, fd, "same ring", CTRL_RING) || !bench(dev, fd, "lane 1 (FIFO_SET_PRIO)", CTRL_LANE) ||
+        !bench(dev, fd, "lane 3 (FIFO_SET_PRIO)", CTRL_LANE_MAX))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Back to byte stream for other applications.
+    ::ioctl(fd, FIFO_CLEAR, 0);
+    ::ioctl(fd, FIFO_SET_MODE, &mode);
+    ::close(fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file main_splice.cpp
+ * @brief Benchmark moving 1 GiB from globalfifo into a file by read() + write() vs. splice().
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_splice [device] [output file], e.g. ./main_splice /dev/globalfifo0 /tmp/globalfifo.out
+ * A producer thread writes into the FIFO, the consumer moves data into output file. Larger ring
+ * capacity (/sys/class/globalfifo/globalfifo0/capacity) reduces blocking of both sides.
+ */
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define TOTAL_BYTES (1UL << 30)
+#define CHUNK_SIZE (64 * 1024)
+
+using Clock = std::chrono::steady_clock;
+
+static void producer(const char *dev)
+{
+    std::vector<char> buf(CHUNK_SIZE, 'p');
+    int fd = ::open(dev, O_WRONLY);
+
+    for (size_t done = 0; fd >= 0 && done < TOTAL_BYTES;)
+    {
+        ssize_t ret = ::write(fd, buf.data(), std::min((size_t)CHUNK_SIZE, TOTAL_BYTES - done));
+        if (ret < 0)
+        {
+            std::perror("write");
+            break;
+        }
+        done += ret;
+    }
+    ::close(fd);
+}
+
+// Copy through user buffer.
+static ssize_t copyReadWrite(int in, int out)
+{
+    std::vector<char> buf(CHUNK_SIZE);
+    size_t done = 0;
+
+    while (done < TOTAL_BYTES)
+    {
+        ssize_t ret = ::read(in, buf.data(), std::min((size_t)CHUNK_SIZE, TOTAL_BYTES - done));
+        if (ret <= 0 || ::write(out, buf.data(), ret) != ret)
+        {
+            return -1;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+// Device -> pipe -> file, data pages never pass user space.
+static ssize_t copySplice(int in, int out)
+{
+    int pipefd[2];
+    size_t done = 0;
+
+    if (::pipe(pipefd) < 0)
+    {
+        return -1;
+    }
+    ::fcntl(pipefd[1], F_SETPIPE_SZ, CHUNK_SIZE);
+    while (done < TOTAL_BYTES)
+    {
+        ssize_t ret = ::splice(in, nullptr, pipefd[1], nullptr, std::min((size_t)CHUNK_SIZE, TOTAL_BYTES - done),
+                               SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (ret <= 0)
+        {
+            break;
+        }
+        // Drain pipe completely into file.
+        for (ssize_t left = ret; left > 0;)
+        {
+            ssize_t n = ::splice(pipefd[0], nullptr, out, nullptr, left, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n <= 0)
+            {
+                ::close(pipefd[0]);
+                ::close(pipefd[1]);
+                return -1;
+            }
+            left -= n;
+        }
+        done += ret;
+    }
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    return done == TOTAL_BYTES ? (ssize_t)done : -1;
+}
+
+static bool bench(const char *name, const char *dev, const char *file, ssize_t (*copy)(int, int))
+{
+    int in, out;
+
+    std::thread writer(producer, dev);
+    if ((in = ::open(dev, O_RDONLY)) == -1 || (out = ::open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+    {
+        std::perror("open");
+        writer.detach();
+        return false;
+    }
+
+    auto begin = Clock::now();
+    ssize_t bytes = copy(in, out);
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+    if (bytes < 0)
+    {
+        std::perror(name);
+        writer.detach();
+        return false;
+    }
+    writer.join();
+    ::close(in);
+    ::close(out);
+
+    std::cout << name << ": " << bytes << " bytes in " << sec << " s, " << (uint64_t)(bytes / sec / (1 << 20))
+              << " MiB/s\n";
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    const char *file = argc > 2 ? argv[2] : "/tmp/globalfifo.out";
+
+    if (!bench("read/write", dev, file, copyReadWrite) || !bench("splice", dev, file, copySplice))
+    {
+        return EXIT_FAILURE;
+    }
+    ::unlink(file);
+    return EXIT_SUCCESS;
+}
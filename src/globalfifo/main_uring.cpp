@@ -0,0 +1,241 @@
+/**
+ * @file main_uring.cpp
+ * @brief Benchmark io_uring reads (many requests in flight) against blocking read() on globalfifo.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_uring [device] [queue depth], e.g. ./main_uring /dev/globalmem 256
+ * io_uring is driven by raw syscalls, liburing is not required.
+ */
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define IO_SIZE 64
+#define IO_COUNT 200000
+#define QUEUE_DEPTH 256
+
+using Clock = std::chrono::steady_clock;
+
+// Minimal io_uring: submission / completion rings mapped from kernel.
+struct Uring
+{
+    int fd = -1;
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_sqe *sqes;
+    io_uring_cqe *cqes;
+    unsigned localTail = 0;
+    unsigned toSubmit = 0;
+
+    bool init(unsigned entries)
+    {
+        io_uring_params p;
+        ::memset(&p, 0, sizeof(p));
+        if ((fd = ::syscall(__NR_io_uring_setup, entries, &p)) < 0)
+        {
+            return false;
+        }
+
+        size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+        {
+            sqSize = cqSize = std::max(sqSize, cqSize);
+        }
+
+        char *sq = (char *)::mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        char *cq = single ? sq : (char *)::mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes = (io_uring_sqe *)::mmap(nullptr, p.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            return false;
+        }
+
+        sqTail = (unsigned *)(sq + p.sq_off.tail);
+        sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+        sqArray = (unsigned *)(sq + p.sq_off.array);
+        cqHead = (unsigned *)(cq + p.cq_off.head);
+        cqTail = (unsigned *)(cq + p.cq_off.tail);
+        cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+        localTail = *sqTail;
+        return true;
+    }
+
+    void prepRead(int devFd, void *buf, unsigned len, uint64_t userData)
+    {
+        unsigned idx = localTail & *sqMask;
+        io_uring_sqe *sqe = &sqes[idx];
+
+        ::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = devFd;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = len;
+        sqe->off = 0;
+        sqe->user_data = userData;
+        sqArray[idx] = idx;
+        localTail++;
+        toSubmit++;
+    }
+
+    // Publish queued SQEs and wait for at least one completion.
+    int submitAndWait()
+    {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        int ret = ::syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret >= 0)
+        {
+            toSubmit -= ret;
+        }
+        return ret;
+    }
+};
+
+static std::atomic<bool> stopWriter(false);
+
+// Keep the FIFO filled so that reads measure the device path, not waiting for data.
+static void writerThread(const char *dev)
+{
+    char buf[IO_SIZE];
+    int fd = ::open(dev, O_WRONLY);
+
+    ::memset(buf, 'w', sizeof(buf));
+    while (fd >= 0 && !stopWriter)
+    {
+        if (::write(fd, buf, sizeof(buf)) < 0)
+        {
+            break;
+        }
+    }
+}
+
+static void report(const char *name, std::vector<double> &lat, double sec)
+{
+    double sum = 0;
+    for (double v : lat)
+    {
+        sum += v;
+    }
+    std::sort(lat.begin(), lat.end());
+    std::cout << name << ": " << (uint64_t)(lat.size() / sec) << " ops/s, latency avg "
+              << (uint64_t)(sum / lat.size()) << " ns, p99 " << (uint64_t)lat[lat.size() * 99 / 100] << " ns\n";
+}
+
+static bool benchBlocking(int fd)
+{
+    char buf[IO_SIZE];
+    std::vector<double> lat;
+
+    lat.reserve(IO_COUNT);
+    auto begin = Clock::now();
+    for (int i = 0; i < IO_COUNT; i++)
+    {
+        auto t0 = Clock::now();
+        if (::read(fd, buf, sizeof(buf)) < 0)
+        {
+            std::perror("read");
+            return false;
+        }
+        lat.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+    }
+    report("blocking read", lat, std::chrono::duration<double>(Clock::now() - begin).count());
+    return true;
+}
+
+static bool benchUring(int fd, unsigned depth)
+{
+    Uring ring;
+    std::vector<char> bufs(depth * IO_SIZE);
+    std::vector<Clock::time_point> submitted(depth);
+    std::vector<double> lat;
+    int issued = 0, completed = 0;
+
+    if (!ring.init(depth))
+    {
+        std::perror("io_uring_setup");
+        return false;
+    }
+
+    lat.reserve(IO_COUNT);
+    auto begin = Clock::now();
+    // Keep 'depth' reads in flight, each slot owns a buffer and is resubmitted on completion.
+    for (unsigned slot = 0; slot < depth && issued < IO_COUNT; slot++, issued++)
+    {
+        submitted[slot] = Clock::now();
+        ring.prepRead(fd, &bufs[slot * IO_SIZE], IO_SIZE, slot);
+    }
+
+    while (completed < IO_COUNT)
+    {
+        if (ring.submitAndWait() < 0)
+        {
+            std::perror("io_uring_enter");
+            return false;
+        }
+
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+            unsigned slot = cqe->user_data;
+
+            if (cqe->res < 0)
+            {
+                std::cout << "read failed: " << std::strerror(-cqe->res) << "\n";
+                return false;
+            }
+            lat.push_back(std::chrono::duration<double, std::nano>(Clock::now() - submitted[slot]).count());
+            completed++;
+
+            if (issued < IO_COUNT)
+            {
+                submitted[slot] = Clock::now();
+                ring.prepRead(fd, &bufs[slot * IO_SIZE], IO_SIZE, slot);
+                issued++;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    }
+    report("io_uring read", lat, std::chrono::duration<double>(Clock::now() - begin).count());
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    unsigned depth = argc > 2 ? std::atoi(argv[2]) : QUEUE_DEPTH;
+    int fd;
+
+    if ((fd = ::open(dev, O_RDONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        return EXIT_FAILURE;
+    }
+
+    // Writer might be blocked on full FIFO at exit, it is terminated with the process.
+    std::thread(writerThread, dev).detach();
+
+    if (!benchBlocking(fd) || !benchUring(fd, depth))
+    {
+        return EXIT_FAILURE;
+    }
+
+    stopWriter = true;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file main_write.cpp
+ * @brief Compare write() calls per message for short writes, FIFO_WRITE_ATOMIC and FIFO_WRITE_ALL on globalfifo.
+ * @author agent (agent@local)
+ * @date 2026-10-17
+ * @copyright Copyright (c) 2026 agent
+ *
+ * Usage: ./main_write [device] [message size], message size defaults to 3 KiB.
+ * A writer sends messages in byte stream mode, by default it loops on short writes. One reader drains the FIFO.
+ * First checks that a large atomic writer blocked on a full FIFO doesn't keep a smaller one asleep once it fits.
+ */
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "globalfifo.h"
+
+#define MSG_COUNT 100000
+
+using Clock = std::chrono::steady_clock;
+
+static void atomicWriterThread(const char *dev, size_t len, std::atomic<bool> *done)
+{
+    std::vector<char> msg(len, 'a');
+    __u32 flags = FIFO_WRITE_ATOMIC;
+    int fd = ::open(dev, O_WRONLY);
+
+    if (fd >= 0 && ::ioctl(fd, FIFO_SET_WRITE_FLAGS, &flags) == 0 && ::write(fd, msg.data(), len) != (ssize_t)len)
+    {
+        std::perror("write");
+    }
+    ::close(fd);
+    *done = true;
+}
+
+/**
+ * Fill the FIFO, block an atomic writer needing nearly all of it, then a small one behind it, and free
+ * space for the small one only: it has to complete although the large one is woken first and doesn't fit.
+ */
+static bool checkAtomicWakeup(const char *dev, int fd)
+{
+    std::atomic<bool> bigDone(false), smallDone(false);
+    __u32 size;
+    int wfd;
+
+    if (::ioctl(fd, FIFO_GET_SIZE, &size) < 0 || ::ioctl(fd, FIFO_CLEAR, 0) < 0 ||
+        (wfd = ::open(dev, O_WRONLY | O_NONBLOCK)) < 0)
+    {
+        std::perror("FIFO_GET_SIZE");
+        return false;
+    }
+    std::vector<char> buf(size, 'f');
+    for (size_t done = 0; done < size;)
+    {
+        ssize_t ret = ::write(wfd, buf.data(), size - done);
+        if (ret <= 0)
+        {
+            break;
+        }
+        done += ret;
+    }
+    ::close(wfd);
+
+    std::thread big(atomicWriterThread, dev, size - 256, &bigDone);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread small(atomicWriterThread, dev, 256, &smallDone);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Free 512 bytes: enough for the small writer only.
+    bool ok = ::read(fd, buf.data(), 512) == 512;
+    for (int i = 0; ok && i < 100 && !smallDone; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ok = ok && smallDone && !bigDone;
+
+    // Release the large writer.
+    while (!bigDone)
+    {
+        ::ioctl(fd, FIFO_CLEAR, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    big.join();
+    small.join();
+    ::ioctl(fd, FIFO_CLEAR, 0);
+
+    std::cout << "atomic writers wakeup check: " << (ok ? "ok" : "FAILED, small writer not woken") << "\n";
+    return ok;
+}
+
+static void writerThread(const char *dev, __u32 flags, size_t msgSize, uint64_t *calls)
+{
+    std::vector<char> msg(msgSize, 'w');
+    int fd = ::open(dev, O_WRONLY);
+
+    if (fd < 0 || ::ioctl(fd, FIFO_SET_WRITE_FLAGS, &flags) < 0)
+    {
+        std::perror("FIFO_SET_WRITE_FLAGS");
+        ::close(fd);
+        return;
+    }
+    for (int i = 0; i < MSG_COUNT; i++)
+    {
+        // Without FIFO_WRITE_ALL the rest of a short write is sent again.
+        for (size_t done = 0; done < msgSize;)
+        {
+            ssize_t ret = ::write(fd, msg.data() + done, msgSize - done);
+            (*calls)++;
+            if (ret < 0)
+            {
+                std::perror("write");
+                ::close(fd);
+                return;
+            }
+            done += ret;
+        }
+    }
+    ::close(fd);
+}
+
+static bool bench(const char *dev, int fd, const char *name, __u32 flags, size_t msgSize)
+{
+    std::vector<char> buf(64 << 10);
+    size_t total = msgSize * MSG_COUNT;
+    uint64_t calls = 0;
+
+    if (::ioctl(fd, FIFO_CLEAR, 0) < 0)
+    {
+        std::perror("FIFO_CLEAR");
+        return false;
+    }
+
+    auto begin = Clock::now();
+    std::thread writer(writerThread, dev, flags, msgSize, &calls);
+    for (size_t done = 0; done < total;)
+    {
+        ssize_t ret = ::read(fd, buf.data(), buf.size());
+        if (ret < 0)
+        {
+            std::perror("read");
+            writer.detach();
+            return false;
+        }
+        done += ret;
+    }
+    writer.join();
+    double sec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    std::cout << name << ": " << (double)calls / MSG_COUNT << " write() per message, "
+              << (uint64_t)(MSG_COUNT / sec) << " msgs/s\n";
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dev = argc > 1 ? argv[1] : "/dev/globalfifo0";
+    size_t msgSize = argc > 2 ? std::atoi(argv[2]) : 3072;
+    __u32 mode = 0;
+    int fd;
+
+    if ((fd = ::open(dev, O_RDONLY)) == -1)
+    {
+        std::cout << "Device open failure\n";
+        return EXIT_FAILURE;
+    }
+    if (::ioctl(fd, FIFO_CLEAR, 0) < 0 || ::ioctl(fd, FIFO_SET_MODE, &mode) < 0)
+    {
+        std::perror("FIFO_SET_MODE");
+        return EXIT_FAILURE;
+    }
+
+    if (!checkAtomicWakeup(dev, fd) || !bench(dev, fd, "short writes", 0, msgSize) ||
+        !bench(dev, fd, "FIFO_WRITE_ATOMIC", FIFO_WRITE_ATOMIC, msgSize) ||
+        !bench(dev, fd, "FIFO_WRITE_ALL", FIFO_WRITE_ALL, msgSize))
+    {
+        return EXIT_FAILURE;
+    }
+
+    ::close(fd);
+    return EXIT_SUCCESS;
+}
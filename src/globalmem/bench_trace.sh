@@ -0,0 +1,26 @@
+#!/bin/sh
+# Compare globalmem read / write syscall latency with printk logging vs. tracepoints.
+# Run as root after "insmod ./globalmem.ko" and "make userapp".
+
+PARAM=/sys/module/globalmem/parameters/globalmem_log_io
+EVENTS=/sys/kernel/tracing/events/globalmem
+[ -d $EVENTS ] || EVENTS=/sys/kernel/debug/tracing/events/globalmem
+
+run()
+{
+    echo "== $1"
+    # Option d: syscall latency benchmark, option 8: exit.
+    printf 'd\n8\n' | ./main_app | grep latency
+}
+
+echo 0 > $PARAM
+echo 0 > $EVENTS/enable
+run "logging off, tracepoints disabled"
+
+echo 1 > $PARAM
+run "printk logging"
+echo 0 > $PARAM
+
+echo 1 > $EVENTS/enable
+run "tracepoints enabled"
+echo 0 > $EVENTS/enable
@@ -23,12 +23,20 @@
 #include <linux/hrtimer.h>
 #include <linux/ktime.h>
 #include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/rwsem.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uio.h>
+#include "globalmem.h"
 
-#define GLOBALMEM_SIZE 0x1000
-#define GLOBALMEM_MAGIC 'g'
+#define CREATE_TRACE_POINTS
+#include "globalmem_trace.h"
 
-// An ioctl with write parameters (copy_from_user)
-#define MEM_CLEAR _IOW(GLOBALMEM_MAGIC, 0x01, int32_t *)
+#define GLOBALMEM_SIZE 0x1000           // Default buffer size.
+#define GLOBALMEM_SIZE_MAX (1UL << 30)  // Upper limit of buffer size (1 GiB).
 
 // Automatic creation of device files can be handled with udev.
 static dev_t dev_no = 0;
@@ -52,17 +60,77 @@ const struct kernel_param_ops my_param_ops = {
 
 module_param_cb(globalmem_cb_value, &my_param_ops, &globalmem_cb_value, S_IRUGO | S_IWUSR);
 
+// Initial buffer size in bytes (rounded up to page size), could be changed later by ioctl MEM_RESIZE.
+static unsigned long globalmem_size = GLOBALMEM_SIZE;
+module_param(globalmem_size, ulong, S_IRUGO);
+
+/*
+Concurrency mode:
+- 1: readers share the buffer, writers only exclude accesses to overlapping byte ranges.
+- 0: every read / write takes the buffer exclusively.
+*/
+static bool globalmem_concurrent = true;
+module_param(globalmem_concurrent, bool, S_IRUGO | S_IWUSR);
+
+// Log every read / write / poll by printk, use tracepoints in events/globalmem instead for production.
+static bool globalmem_log_io = false;
+module_param(globalmem_log_io, bool, S_IRUGO | S_IWUSR);
+
 /*************** device struct**********************/
-// Common character device struct and encapsulated memory buffer mem[]
+// Latency histogram bucket i counts latencies in [2^(i-1), 2^i) ns, the last one counts anything longer.
+#define GLOBALMEM_LAT_BUCKETS 32
+
+// Per-CPU statistics, summed up when /sys/kernel/debug/globalmem/stats is read.
+struct globalmem_stats {
+    u64 read_ops;
+    u64 read_bytes;
+    u64 write_ops;
+    u64 write_bytes;
+    u64 read_errors;    // Failed requests (-EFAULT, -EAGAIN, ...), not in ops and latency.
+    u64 write_errors;
+    u64 lock_contended; // Buffer lock or byte range lock not available at first try.
+    u64 poll_wakeups;   // Wakeups of poll wait queue.
+    u64 read_lat[GLOBALMEM_LAT_BUCKETS];
+    u64 write_lat[GLOBALMEM_LAT_BUCKETS];
+};
+
+// Byte range [start, end) of mem[] locked by a reader or writer.
+struct globalmem_range {
+    struct list_head node;
+    loff_t start;
+    loff_t end;
+    bool write;
+};
+
+// Common character device struct and page-backed memory buffer mem[]
 struct globalmem_dev {
     struct cdev cdev;
-    unsigned char mem[GLOBALMEM_SIZE];
+    // Allocated by vmalloc_user() (zeroed, page aligned) so it can be mapped to user space.
+    unsigned char *mem;
+    size_t size;
+    // Number of active user space mappings, buffer can't be resized while mapped.
+    atomic_t mmap_count;
+    /*
+    Serialize mmap() against buffer replacement.
+    - mmap() is called with mmap_lock held, while copy_xxx_user under rwsem might fault and take mmap_lock,
+      so mmap() can't take rwsem, lock order: rwsem -> mmap_mutex.
+    */
+    struct mutex mmap_mutex;
     /*
-    Concurrent access control using mutex.
+    Concurrent access control using read-write semaphore.
     - spin lock can't use because copy_xxx_user might block the process.
-    - mutex used for demo purpose, not all places are added.
+    - read() / write() hold it shared and lock their byte range in ranges list, so accesses to
+      disjoint ranges run in parallel.
+    - MEM_CLEAR / MEM_RESIZE hold it exclusively.
+    - seqcount is not used, copy_to_user() might sleep in the read side critical section.
     */
-    struct mutex mutex;
+    struct rw_semaphore rwsem;
+    // Locked byte ranges, protected by range_lock. Waiters sleep on range_wait until conflict released.
+    struct list_head ranges;
+    spinlock_t range_lock;
+    wait_queue_head_t range_wait;
+    // Updated locally on each CPU, so recording doesn't add contention.
+    struct globalmem_stats __percpu *stats;
 };
 
 struct globalmem_dev *globalmem_devp;
@@ -71,22 +139,29 @@ struct globalmem_dev *globalmem_devp;
 static int globalmem_open(struct inode *inode, struct file *filp);
 static int globalmem_release(struct inode *inode, struct file *filp);
 static long globalmem_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
-static ssize_t globalmem_read(struct file *filp, char __user *buf, size_t size, loff_t *ppos);
-static ssize_t globalmem_write(struct file *filp, const char __user *buf, size_t size, loff_t *ppos);
+static ssize_t globalmem_read_iter(struct kiocb *iocb, struct iov_iter *to);
+static ssize_t globalmem_write_iter(struct kiocb *iocb, struct iov_iter *from);
 static loff_t globalmem_llseek(struct file *filp, loff_t offset, int orig);
 static unsigned int globalmem_poll(struct file *filp, struct poll_table_struct *wait);
+static int globalmem_mmap(struct file *filp, struct vm_area_struct *vma);
 
 static const struct file_operations globalmem_fops = {
     .owner = THIS_MODULE,
     .llseek = globalmem_llseek, // Change current position.
-    .read = globalmem_read,
-    .write = globalmem_write,
+    .read_iter = globalmem_read_iter,   // read() / readv() / preadv2(), all segments under one lock.
+    .write_iter = globalmem_write_iter, // write() / writev() / pwritev2().
+    .splice_read = generic_file_splice_read, // splice() / sendfile() to pipe via read_iter.
+    .splice_write = iter_file_splice_write,  // splice() from pipe via write_iter.
     .unlocked_ioctl = globalmem_ioctl, // Realize device control command, map to user space fcntl() / ioctl().
     .open = globalmem_open,
     .release = globalmem_release,
-    .poll = globalmem_poll
+    .poll = globalmem_poll,
+    .mmap = globalmem_mmap // Map mem[] buffer to user space (zero-copy access).
 };
 
+/***************** Debugfs *******************/
+static struct dentry *globalmem_debugfs;
+
 /***************** Procfs *******************/
 char globalmem_proc_array[20] = "try proc array\n";
 int globalmem_proc_len = 1;
@@ -163,7 +238,6 @@ seqlock_t globalmem_seq_lock;
 
 /***************** signal *******************/
 #define SIGETX 44
-#define REG_CURRENT_TASK _IOW(GLOBALMEM_MAGIC, 0x02, int32_t *)
 static struct task_struct *sig_task = NULL;
 static int sig_num = 0;
 
@@ -388,6 +462,7 @@ static ssize_t sysfs_show(struct kobject *kobj,
 
     // Wake up poll wait queue can write date from user space.
     can_write = true;
+    this_cpu_inc(globalmem_devp->stats->poll_wakeups);
     wake_up(&wait_queue_globalmem_data);
 
     return sprintf(buf, "%d", sysfs_value);
@@ -404,6 +479,7 @@ static ssize_t sysfs_store(struct kobject *kobj,
 
     // Wake up poll wait queue can read data from user space.
     can_read = true;
+    this_cpu_inc(globalmem_devp->stats->poll_wakeups);
     wake_up(&wait_queue_globalmem_data);
 
     return count;
@@ -521,6 +597,11 @@ static int globalmem_open(struct inode *inode, struct file *filp)
     pr_info("Device driver file opened\n");
     // Pointer private_data to device struct.
     filp->private_data = globalmem_devp;
+    /*
+     * No FMODE_NOWAIT: poll reports the sysfs handshake, not lock availability, so an io_uring request
+     * that got -EAGAIN on a busy lock would wait for a poll wakeup forever. io_uring runs requests in a
+     * worker instead, IOCB_NOWAIT is still honored for O_NONBLOCK opens.
+     */
     return 0;
 }
 
@@ -538,17 +619,193 @@ static int globalmem_release(struct inode *inode, struct file *filp)
     return 0;
 }
 
+/**
+ * Replace mem[] buffer with a new one of given size, content is preserved up to the smaller size.
+ */
+static int globalmem_resize(struct globalmem_dev *dev, u64 size)
+{
+    unsigned char *mem;
+    int ret = 0;
+
+    if (size == 0 || size > GLOBALMEM_SIZE_MAX)
+        return -EINVAL;
+    size = PAGE_ALIGN(size);
+
+    // Allocate outside of the lock, vmalloc might take long time for large buffer.
+    mem = vmalloc_user(size);
+    if (!mem)
+        return -ENOMEM;
+
+    down_write(&dev->rwsem);
+    mutex_lock(&dev->mmap_mutex);
+    if (atomic_read(&dev->mmap_count)) {
+        // Existing mapping still refers to the old pages.
+        ret = -EBUSY;
+    } else {
+        memcpy(mem, dev->mem, min_t(size_t, size, dev->size));
+        swap(mem, dev->mem);
+        dev->size = size;
+    }
+    mutex_unlock(&dev->mmap_mutex);
+    up_write(&dev->rwsem);
+
+    // Free old buffer on success, or new buffer on failure.
+    vfree(mem);
+
+    return ret;
+}
+
+/**
+ * Account finished read / write request or MEM_BATCH op in per-CPU statistics, failed ones only as errors
+ * so that they don't skew the latency histograms.
+ */
+static void globalmem_account_io(struct globalmem_dev *dev, bool write, ssize_t ret, u64 latency_ns)
+{
+    unsigned int bucket = min_t(unsigned int, fls64(latency_ns), GLOBALMEM_LAT_BUCKETS - 1);
+
+    if (ret < 0) {
+        if (write)
+            this_cpu_inc(dev->stats->write_errors);
+        else
+            this_cpu_inc(dev->stats->read_errors);
+        return;
+    }
+
+    if (write) {
+        this_cpu_inc(dev->stats->write_ops);
+        this_cpu_add(dev->stats->write_bytes, ret);
+        this_cpu_inc(dev->stats->write_lat[bucket]);
+    } else {
+        this_cpu_inc(dev->stats->read_ops);
+        this_cpu_add(dev->stats->read_bytes, ret);
+        this_cpu_inc(dev->stats->read_lat[bucket]);
+    }
+}
+
+/**
+ * Execute one MEM_BATCH op on mem[], caller holds rwsem exclusively.
+ */
+static int globalmem_batch_op(struct globalmem_dev *dev, struct mem_batch_op *op)
+{
+    void __user *ubuf = u64_to_user_ptr(op->user_ptr);
+
+    if (op->offset >= dev->size || op->len > dev->size - op->offset)
+        return -EINVAL;
+
+    switch (op->op) {
+    case MEM_OP_READ:
+        if (copy_to_user(ubuf, dev->mem + op->offset, op->len))
+            return -EFAULT;
+        break;
+    case MEM_OP_WRITE:
+        if (copy_from_user(dev->mem + op->offset, ubuf, op->len))
+            return -EFAULT;
+        break;
+    case MEM_OP_FILL:
+        memset(dev->mem + op->offset, (u8)op->value, op->len);
+        break;
+    case MEM_OP_CAS:
+        if (op->len == 0 || op->len > sizeof(op->value))
+            return -EINVAL;
+        if (memcmp(dev->mem + op->offset, &op->expected, op->len)) {
+            memcpy(&op->expected, dev->mem + op->offset, op->len);
+            return -EAGAIN;
+        }
+        memcpy(dev->mem + op->offset, &op->value, op->len);
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    return op->len;
+}
+
+/**
+ * Execute array of read / write / fill / compare-and-swap ops under one exclusive lock hold,
+ * so other readers / writers see either none or all of them.
+ */
+static int globalmem_batch(struct globalmem_dev *dev, struct mem_batch __user *arg)
+{
+    struct mem_batch batch;
+    struct mem_batch_op *ops;
+    struct mem_batch_op __user *uops;
+    bool failed = false;
+    int ret = 0;
+    u64 start, op_start, lock_wait, latency;
+    u32 i;
+
+    if (copy_from_user(&batch, arg, sizeof(batch)))
+        return -EFAULT;
+    if (batch.count == 0 || batch.count > MEM_BATCH_MAX || batch.flags & ~MEM_BATCH_STOP_ON_ERROR)
+        return -EINVAL;
+
+    uops = u64_to_user_ptr(batch.ops_ptr);
+    ops = memdup_user(uops, batch.count * sizeof(*ops));
+    if (IS_ERR(ops))
+        return PTR_ERR(ops);
+
+    start = ktime_get_ns();
+    down_write(&dev->rwsem);
+    lock_wait = ktime_get_ns() - start;
+    for (i = 0; i < batch.count; i++) {
+        struct mem_batch_op *op = &ops[i];
+        bool write = op->op != MEM_OP_READ;
+
+        if (failed && (batch.flags & MEM_BATCH_STOP_ON_ERROR)) {
+            op->status = -ECANCELED;
+            continue;
+        }
+        op_start = ktime_get_ns();
+        op->status = globalmem_batch_op(dev, op);
+        if (op->status < 0)
+            failed = true;
+
+        // Each op counts like a read / write request which waited for the batch lock.
+        latency = lock_wait + ktime_get_ns() - op_start;
+        globalmem_account_io(dev, write, op->status, latency);
+        if (write)
+            trace_globalmem_write(op->offset, op->len, op->status, latency, lock_wait);
+        else
+            trace_globalmem_read(op->offset, op->len, op->status, latency, lock_wait);
+    }
+    up_write(&dev->rwsem);
+
+    // Write back per-op status and CAS current values.
+    if (copy_to_user(uops, ops, batch.count * sizeof(*ops)))
+        ret = -EFAULT;
+    kfree(ops);
+
+    return ret;
+}
+
 static long globalmem_ioctl(struct file *filp, unsigned int cmd,
                             unsigned long arg)
 {
     // Fetch device instance pointer via private_data member.
     struct globalmem_dev *dev = filp->private_data;
+    u64 size;
 
     switch (cmd) {
     case MEM_CLEAR:
         pr_info("Clear memory buffer to zero\n");
-        memset(dev->mem, 0, GLOBALMEM_SIZE);
+        down_write(&dev->rwsem);
+        memset(dev->mem, 0, dev->size);
+        up_write(&dev->rwsem);
         break;
+    case MEM_RESIZE:
+        if (copy_from_user(&size, (u64 __user *)arg, sizeof(size)))
+            return -EFAULT;
+        pr_info("Resize memory buffer to %llu bytes\n", size);
+        return globalmem_resize(dev, size);
+    case MEM_GET_SIZE:
+        down_read(&dev->rwsem);
+        size = dev->size;
+        up_read(&dev->rwsem);
+        if (copy_to_user((u64 __user *)arg, &size, sizeof(size)))
+            return -EFAULT;
+        break;
+    case MEM_BATCH:
+        return globalmem_batch(dev, (struct mem_batch __user *)arg);
     case REG_CURRENT_TASK:
         pr_info("Register current task\n");
         sig_task = get_current();
@@ -562,33 +819,143 @@ static long globalmem_ioctl(struct file *filp, unsigned int cmd,
 }
 
 /**
- * Read / write mem[] buffer with user space, change file read position accordingly.
+ * Lock buffer according to concurrency mode, set shared to true if it is held shared.
+ * Buffer size is stable until unlock. Return -EAGAIN instead of sleeping if nowait (IOCB_NOWAIT).
  */
-static ssize_t globalmem_read(struct file *filp, char __user *buf, size_t size,
-                              loff_t *ppos)
+static int globalmem_lock(struct globalmem_dev *dev, bool nowait, bool *shared)
 {
-    unsigned long p = *ppos;
-    unsigned int count = size;
-    int ret = 0;
-    struct globalmem_dev *dev = filp->private_data;
+    *shared = READ_ONCE(globalmem_concurrent);
+
+    if (*shared) {
+        if (!down_read_trylock(&dev->rwsem)) {
+            this_cpu_inc(dev->stats->lock_contended);
+            if (nowait)
+                return -EAGAIN;
+            down_read(&dev->rwsem);
+        }
+    } else {
+        if (!down_write_trylock(&dev->rwsem)) {
+            this_cpu_inc(dev->stats->lock_contended);
+            if (nowait)
+                return -EAGAIN;
+            down_write(&dev->rwsem);
+        }
+    }
+    return 0;
+}
 
-    if (p >= GLOBALMEM_SIZE)
-        return 0;
-    if (count > GLOBALMEM_SIZE - p)
-        count = GLOBALMEM_SIZE - p;
+static void globalmem_unlock(struct globalmem_dev *dev, bool shared)
+{
+    if (shared)
+        up_read(&dev->rwsem);
+    else
+        up_write(&dev->rwsem);
+}
+
+/**
+ * Add range to locked list if it doesn't conflict with any locked range (a writer overlaps with anyone).
+ */
+static bool globalmem_range_trylock(struct globalmem_dev *dev, struct globalmem_range *range)
+{
+    struct globalmem_range *cur;
+
+    spin_lock(&dev->range_lock);
+    list_for_each_entry(cur, &dev->ranges, node) {
+        if ((range->write || cur->write) && range->start < cur->end && cur->start < range->end) {
+            spin_unlock(&dev->range_lock);
+            return false;
+        }
+    }
+    list_add_tail(&range->node, &dev->ranges);
+    spin_unlock(&dev->range_lock);
+
+    return true;
+}
+
+/**
+ * Lock byte range [start, end) of mem[], sleep until conflicting ranges are unlocked,
+ * or return -EAGAIN if nowait. Caller must hold rwsem shared.
+ */
+static int globalmem_range_lock(struct globalmem_dev *dev, struct globalmem_range *range,
+                                loff_t start, loff_t end, bool write, bool nowait)
+{
+    range->start = start;
+    range->end = end;
+    range->write = write;
+    if (!globalmem_range_trylock(dev, range)) {
+        this_cpu_inc(dev->stats->lock_contended);
+        if (nowait)
+            return -EAGAIN;
+        wait_event(dev->range_wait, globalmem_range_trylock(dev, range));
+    }
+    return 0;
+}
+
+static void globalmem_range_unlock(struct globalmem_dev *dev, struct globalmem_range *range)
+{
+    spin_lock(&dev->range_lock);
+    list_del(&range->node);
+    spin_unlock(&dev->range_lock);
+
+    if (wq_has_sleeper(&dev->range_wait))
+        wake_up(&dev->range_wait);
+}
+
+/**
+ * Read / write mem[] buffer with user space, change file read position accordingly.
+ * Vectored I/O (readv / writev) copies all segments under one lock acquisition.
+ */
+static ssize_t globalmem_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    loff_t p = iocb->ki_pos;
+    size_t count = iov_iter_count(to);
+    size_t copied;
+    ssize_t ret = 0;
+    struct globalmem_dev *dev = iocb->ki_filp->private_data;
+    struct globalmem_range range;
+    // Async submitter (io_uring) asks not to sleep on locks, it retries from a worker on -EAGAIN.
+    bool nowait = iocb->ki_flags & IOCB_NOWAIT;
+    bool shared;
+    u64 start, locked = 0, latency;
+
+    start = ktime_get_ns();
+
+    // Lock before read shared memory buffer, buffer size might be changed by MEM_RESIZE.
+    ret = globalmem_lock(dev, nowait, &shared);
+    if (ret)
+        goto done;
+    if (p < 0 || p >= dev->size)
+        goto out;
+    if (count > dev->size - p)
+        count = dev->size - p;
+
+    if (shared) {
+        ret = globalmem_range_lock(dev, &range, p, p + count, false, nowait);
+        if (ret)
+            goto out;
+    }
+    locked = ktime_get_ns();
 
-    // Lock before read shared memory buffer.
-    mutex_lock(&dev->mutex);
-    // Check if valid user space address: copy_to_user(void __user *to, const void *from, unsigned long count)
-    if (copy_to_user(buf, dev->mem + p, count)) {
+    // Copy to user segments, stop at the first invalid user space address.
+    copied = copy_to_iter(dev->mem + p, count, to);
+    if (copied == 0 && count != 0) {
         ret = -EFAULT;
     } else {
-        *ppos += count;
-        ret = count;
+        iocb->ki_pos += copied;
+        ret = copied;
 
-        printk(KERN_INFO "read %u bytes(s) from %lu\n", count, p);
+        if (globalmem_log_io)
+            printk(KERN_INFO "read %zu bytes(s) from %lld\n", copied, p);
     }
-    mutex_unlock(&dev->mutex);
+
+    if (shared)
+        globalmem_range_unlock(dev, &range);
+out:
+    globalmem_unlock(dev, shared);
+done:
+    latency = ktime_get_ns() - start;
+    globalmem_account_io(dev, false, ret, latency);
+    trace_globalmem_read(p, count, ret, latency, locked ? locked - start : 0);
 
     // Notify thread read is completed.
     completion_flag = 1;
@@ -599,65 +966,88 @@ static ssize_t globalmem_read(struct file *filp, char __user *buf, size_t size,
     return ret;
 }
 
-static ssize_t globalmem_write(struct file *filp, const char __user *buf,
-                               size_t size, loff_t *ppos)
+static ssize_t globalmem_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
-    unsigned long p = *ppos;
-    unsigned int count = size;
-    int ret = 0;
-    struct globalmem_dev *dev = filp->private_data;
-
-    if (p >= GLOBALMEM_SIZE)
-        return 0;
-    if (count > GLOBALMEM_SIZE - p)
-        count = GLOBALMEM_SIZE - p;
+    loff_t p = iocb->ki_pos;
+    size_t count = iov_iter_count(from);
+    size_t copied;
+    ssize_t ret = 0;
+    struct globalmem_dev *dev = iocb->ki_filp->private_data;
+    struct globalmem_range range;
+    bool nowait = iocb->ki_flags & IOCB_NOWAIT;
+    bool shared;
+    u64 start, locked = 0, latency;
+
+    start = ktime_get_ns();
+
+    // Lock before write shared memory buffer, only the written range is exclusive in concurrent mode.
+    ret = globalmem_lock(dev, nowait, &shared);
+    if (ret)
+        goto done;
+    if (p < 0 || p >= dev->size)
+        goto out;
+    if (count > dev->size - p)
+        count = dev->size - p;
+
+    if (shared) {
+        ret = globalmem_range_lock(dev, &range, p, p + count, true, nowait);
+        if (ret)
+            goto out;
+    }
+    locked = ktime_get_ns();
 
-    // Lock before write shared memory buffer.
-    mutex_lock(&dev->mutex);
-    if (copy_from_user(dev->mem + p, buf, count))
+    copied = copy_from_iter(dev->mem + p, count, from);
+    if (copied == 0 && count != 0)
         ret = -EFAULT;
     else {
-        *ppos += count;
-        ret = count;
+        iocb->ki_pos += copied;
+        ret = copied;
 
-        printk(KERN_INFO "written %u bytes(s) from %lu\n", count, p);
+        if (globalmem_log_io)
+            printk(KERN_INFO "written %zu bytes(s) from %lld\n", copied, p);
     }
-    mutex_unlock(&dev->mutex);
+
+    if (shared)
+        globalmem_range_unlock(dev, &range);
+out:
+    globalmem_unlock(dev, shared);
+done:
+    latency = ktime_get_ns() - start;
+    globalmem_account_io(dev, true, ret, latency);
+    trace_globalmem_write(p, count, ret, latency, locked ? locked - start : 0);
 
     return ret;
 }
 
 static loff_t globalmem_llseek(struct file *filp, loff_t offset, int orig)
 {
+    struct globalmem_dev *dev = filp->private_data;
+    loff_t size;
     loff_t ret = 0;
+
+    down_read(&dev->rwsem);
+    size = dev->size;
+    up_read(&dev->rwsem);
+
     switch (orig) {
     case 0: // SEEK_SET: seek from beginning
-        if (offset < 0) {
-            ret = -EINVAL;
-            break;
-        }
-        if ((unsigned int)offset > GLOBALMEM_SIZE) {
-            ret = -EINVAL;
-            break;
-        }
-        filp->f_pos = (unsigned int)offset;
-        ret = filp->f_pos;
         break;
     case 1: // SEEK_CUR: seek from current
-        if ((filp->f_pos + offset) > GLOBALMEM_SIZE) {
-            ret = -EINVAL;
-            break;
-        }
-        if ((filp->f_pos + offset) < 0) {
-            ret = -EINVAL;
-            break;
-        }
-        filp->f_pos += offset;
-        ret = filp->f_pos;
+        offset += filp->f_pos;
+        break;
+    case 2: // SEEK_END: seek from end of buffer
+        offset += size;
         break;
     default:
+        return -EINVAL;
+    }
+
+    // 64-bit offset within [0, size].
+    if (offset < 0 || offset > size) {
         ret = -EINVAL;
-        break;
+    } else {
+        filp->f_pos = offset;
+        ret = filp->f_pos;
     }
     return ret;
 }
@@ -671,7 +1061,8 @@ static unsigned int globalmem_poll(struct file *filp, struct poll_table_struct *
 
     // Add the wait queue that we have created and return immediately.
     poll_wait(filp, &wait_queue_globalmem_data, wait);
-    pr_info("Poll function\n");
+    if (globalmem_log_io)
+        pr_info("Poll function\n");
 
     if (can_read) {
         can_read = false;
@@ -683,13 +1074,135 @@ static unsigned int globalmem_poll(struct file *filp, struct poll_table_struct *
         mask |= (POLLOUT | POLLWRNORM);
     }
 
+    trace_globalmem_poll(mask);
+
     return mask;
 }
 
+/**
+ * Upper bound (ns) of histogram bucket where given percentile of samples fall in.
+ */
+static u64 globalmem_lat_percentile(const u64 *hist, unsigned int percent)
+{
+    u64 total = 0, sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < GLOBALMEM_LAT_BUCKETS; i++)
+        total += hist[i];
+    if (total == 0)
+        return 0;
+
+    for (i = 0; i < GLOBALMEM_LAT_BUCKETS; i++) {
+        sum += hist[i];
+        if (sum * 100 >= total * percent)
+            break;
+    }
+    return 1ULL << min_t(unsigned int, i, GLOBALMEM_LAT_BUCKETS - 1);
+}
+
+static void globalmem_show_hist(struct seq_file *m, const char *name, const u64 *hist)
+{
+    unsigned int i;
+
+    seq_printf(m, "%s_latency_p50_ns: %llu\n", name, globalmem_lat_percentile(hist, 50));
+    seq_printf(m, "%s_latency_p99_ns: %llu\n", name, globalmem_lat_percentile(hist, 99));
+    seq_printf(m, "%s_latency_hist:\n", name);
+    for (i = 0; i < GLOBALMEM_LAT_BUCKETS; i++) {
+        if (hist[i])
+            seq_printf(m, "  < %llu ns: %llu\n", 1ULL << i, hist[i]);
+    }
+}
+
+/**
+ * This function will be called when we read /sys/kernel/debug/globalmem/stats.
+ */
+static int globalmem_stats_show(struct seq_file *m, void *v)
+{
+    struct globalmem_dev *dev = m->private;
+    struct globalmem_stats sum = {0};
+    unsigned int i;
+    int cpu;
+
+    // Sum up per-CPU counters, values might be slightly inconsistent with each other.
+    for_each_possible_cpu(cpu) {
+        struct globalmem_stats *st = per_cpu_ptr(dev->stats, cpu);
+
+        sum.read_ops += st->read_ops;
+        sum.read_bytes += st->read_bytes;
+        sum.write_ops += st->write_ops;
+        sum.write_bytes += st->write_bytes;
+        sum.read_errors += st->read_errors;
+        sum.write_errors += st->write_errors;
+        sum.lock_contended += st->lock_contended;
+        sum.poll_wakeups += st->poll_wakeups;
+        for (i = 0; i < GLOBALMEM_LAT_BUCKETS; i++) {
+            sum.read_lat[i] += st->read_lat[i];
+            sum.write_lat[i] += st->write_lat[i];
+        }
+    }
+
+    seq_printf(m, "read_ops: %llu\n", sum.read_ops);
+    seq_printf(m, "read_bytes: %llu\n", sum.read_bytes);
+    seq_printf(m, "write_ops: %llu\n", sum.write_ops);
+    seq_printf(m, "write_bytes: %llu\n", sum.write_bytes);
+    seq_printf(m, "read_errors: %llu\n", sum.read_errors);
+    seq_printf(m, "write_errors: %llu\n", sum.write_errors);
+    seq_printf(m, "lock_contended: %llu\n", sum.lock_contended);
+    seq_printf(m, "poll_wakeups: %llu\n", sum.poll_wakeups);
+    globalmem_show_hist(m, "read", sum.read_lat);
+    globalmem_show_hist(m, "write", sum.write_lat);
+
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(globalmem_stats);
+
+/**
+ * Track active mappings (vma copied by fork or split by munmap / mprotect).
+ */
+static void globalmem_vma_open(struct vm_area_struct *vma)
+{
+    struct globalmem_dev *dev = vma->vm_private_data;
+    atomic_inc(&dev->mmap_count);
+}
+
+static void globalmem_vma_close(struct vm_area_struct *vma)
+{
+    struct globalmem_dev *dev = vma->vm_private_data;
+    atomic_dec(&dev->mmap_count);
+}
+
+static const struct vm_operations_struct globalmem_vm_ops = {
+    .open = globalmem_vma_open,
+    .close = globalmem_vma_close,
+};
+
+/**
+ * This function will be called when app calls mmap() to map mem[] buffer directly.
+ * Accesses through the mapping bypass dev->rwsem, user space has to synchronize by itself.
+ */
+static int globalmem_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+    struct globalmem_dev *dev = filp->private_data;
+    int ret;
+
+    mutex_lock(&dev->mmap_mutex);
+    // Reject mapping beyond mem[] buffer and set VM_DONTEXPAND | VM_DONTDUMP flags.
+    ret = remap_vmalloc_range(vma, dev->mem, vma->vm_pgoff);
+    if (ret == 0) {
+        vma->vm_private_data = dev;
+        vma->vm_ops = &globalmem_vm_ops;
+        // vm_ops->open() is not called for the initial mapping.
+        globalmem_vma_open(vma);
+    }
+    mutex_unlock(&dev->mmap_mutex);
+
+    return ret;
+}
+
 /**
  * Initialize and add cdev to system.
  */
-static void globalmem_setup_cdev(struct globalmem_dev *dev, int index)
+static int globalmem_setup_cdev(struct globalmem_dev *dev, int index)
 {
     int err;
     // Initialize cdev members and set file operation callback functions.
@@ -699,6 +1212,7 @@ static void globalmem_setup_cdev(struct globalmem_dev *dev, int index)
     err = cdev_add(&dev->cdev, dev_no, 1);
     if (err)
         printk(KERN_NOTICE "Error %d adding globalmem%d", err, index);
+    return err;
 }
 
 /**
@@ -708,6 +1222,7 @@ static int __init globalmem_init(void)
 {
     int ret;
     ktime_t ktime;
+    struct device *device;
 
     /*
     Use kernel module arguments.
@@ -725,26 +1240,62 @@ static int __init globalmem_init(void)
         goto fail_malloc;
     }
 
+    // Page-backed buffer could be mapped to user space by mmap().
+    if (globalmem_size == 0 || globalmem_size > GLOBALMEM_SIZE_MAX) {
+        pr_err("Invalid globalmem_size %lu\n", globalmem_size);
+        ret = -EINVAL;
+        goto r_mem;
+    }
+    globalmem_devp->size = PAGE_ALIGN(globalmem_size);
+    globalmem_devp->mem = vmalloc_user(globalmem_devp->size);
+    if (!globalmem_devp->mem) {
+        ret = -ENOMEM;
+        goto r_mem;
+    }
+
+    globalmem_devp->stats = alloc_percpu(struct globalmem_stats);
+    if (!globalmem_devp->stats) {
+        ret = -ENOMEM;
+        goto r_stats;
+    }
+
+    init_rwsem(&globalmem_devp->rwsem);
+    INIT_LIST_HEAD(&globalmem_devp->ranges);
+    spin_lock_init(&globalmem_devp->range_lock);
+    init_waitqueue_head(&globalmem_devp->range_wait);
+    mutex_init(&globalmem_devp->mmap_mutex);
+    // Completed by read().
+    init_completion(&data_read_complete);
+
     /*
     Automatic create device file.
     */
     // Allocating Major number, see /proc/devices
-    if ((alloc_chrdev_region(&dev_no, 0, 1, "globalmem")) < 0) {
+    ret = alloc_chrdev_region(&dev_no, 0, 1, "globalmem");
+    if (ret < 0) {
         pr_err("Cannot allocate major number for device\n");
-        return -1;
+        goto r_chrdev;
     }
     pr_info("Major = %d Minor = %d \n", MAJOR(dev_no), MINOR(dev_no));
 
+    // Device is live once cdev is added, its state is initialized above.
+    ret = globalmem_setup_cdev(globalmem_devp, 0);
+    if (ret)
+        goto r_cdev;
+
     // Creating struct class structure under/sys/class/xxx.
     dev_class = class_create(THIS_MODULE, "globalmem");
     if (IS_ERR(dev_class)) {
         pr_err("Cannot create the struct class for device\n");
+        ret = PTR_ERR(dev_class);
         goto r_class;
     }
 
     // Creating device, A “dev” file will be created: /dev/xxx
-    if (IS_ERR(device_create(dev_class, NULL, dev_no, NULL, "globalmem"))) {
+    device = device_create(dev_class, NULL, dev_no, NULL, "globalmem");
+    if (IS_ERR(device)) {
         pr_err("Cannot create the Device\n");
+        ret = PTR_ERR(device);
         goto r_device;
     }
 
@@ -752,7 +1303,8 @@ static int __init globalmem_init(void)
     proc_parent = proc_mkdir("example", NULL);
     if (proc_parent == NULL) {
         pr_info("Error creating proc entry");
-        goto r_device;
+        ret = -ENOMEM;
+        goto r_proc;
     }
     // Creating Proc entry under "/proc/globalmem/".
     proc_create("globalmem", 0666, proc_parent, &proc_fops);
@@ -761,11 +1313,16 @@ static int __init globalmem_init(void)
     kobj_ref = kobject_create_and_add("example_sysfs", kernel_kobj);
 
     // Creating sysfs file for globalmem_value.
-    if (sysfs_create_file(kobj_ref, &globalmem_attr.attr)) {
+    ret = sysfs_create_file(kobj_ref, &globalmem_attr.attr);
+    if (ret) {
         pr_err("Cannot create sysfs file......\n");
         goto r_sysfs;
     }
 
+    // Read-only statistics under /sys/kernel/debug/globalmem/, debugfs failure is not fatal.
+    globalmem_debugfs = debugfs_create_dir("globalmem", NULL);
+    debugfs_create_file("stats", 0444, globalmem_debugfs, globalmem_devp, &globalmem_stats_fops);
+
     // Initialize wait queue and kernel thread.
     init_waitqueue_head(&wait_queue_exit);
     wait_thread = kthread_create(wait_function, NULL, "WaitThread");
@@ -775,8 +1332,7 @@ static int __init globalmem_init(void)
     } else
         pr_info("Thread creation failed\n");
 
-    // Initialize completion and kernel thread.
-    init_completion(&data_read_complete);
+    // Kernel thread waiting for read completion.
     wait_thread2 = kthread_create(wait_function2, NULL, "WaitThread2");
     if (wait_thread2) {
         pr_info("Thread created successfully\n");
@@ -786,9 +1342,10 @@ static int __init globalmem_init(void)
     }
 
     // Register an interrupt handler.
-    if (request_irq(IRQ_NO, irq_handler, IRQF_SHARED, "globalmem", (void *)(irq_handler))) {
+    ret = request_irq(IRQ_NO, irq_handler, IRQF_SHARED, "globalmem", (void *)(irq_handler));
+    if (ret) {
         pr_err("my_device: cannot register IRQ ");
-        goto irq;
+        goto r_irq;
     }
 
     // Creating work by Dynamic Method.
@@ -801,6 +1358,7 @@ static int __init globalmem_init(void)
         wake_up_process(globalmem_thread);
     } else {
         pr_err("Cannot create kthread\n");
+        ret = -ENOMEM;
         goto irq;
     }
     globalmem_thread2 = kthread_run(thread_function2, NULL, "globalmem Thread 2");
@@ -808,6 +1366,7 @@ static int __init globalmem_init(void)
         pr_info("Kthread2 created successfully...\n");
     } else {
         pr_err("Cannot create kthread2\n");
+        ret = -ENOMEM;
         goto irq;
     }
 
@@ -815,6 +1374,7 @@ static int __init globalmem_init(void)
     tasklet = kmalloc(sizeof(struct tasklet_struct), GFP_KERNEL);
     if (tasklet == NULL) {
         pr_info("globalmem_device: cannot allocate Memory");
+        ret = -ENOMEM;
         goto irq;
     }
     tasklet_init(tasklet, tasklet_fn, 0);
@@ -836,25 +1396,32 @@ static int __init globalmem_init(void)
     globalmem_hr_timer.function = &hr_timer_callback;
     hrtimer_start( &globalmem_hr_timer, ktime, HRTIMER_MODE_REL);
 
-    globalmem_setup_cdev(globalmem_devp, 0);
-    mutex_init(&globalmem_devp->mutex);
-
     pr_info("Kernel module inserted successfully...\n");
     return 0;
 
 irq:
     free_irq(IRQ_NO,(void *)(irq_handler));
+r_irq:
+    debugfs_remove_recursive(globalmem_debugfs);
 r_sysfs:
     kobject_put(kobj_ref);
     sysfs_remove_file(kernel_kobj, &globalmem_attr.attr);
+    proc_remove(proc_parent);
+r_proc:
+    device_destroy(dev_class, dev_no);
 r_device:
     class_destroy(dev_class);
 r_class:
+    cdev_del(&globalmem_devp->cdev);
+r_cdev:
     unregister_chrdev_region(dev_no, 1);
-    return -1;
-
+r_chrdev:
+    free_percpu(globalmem_devp->stats);
+r_stats:
+    vfree(globalmem_devp->mem);
+r_mem:
+    kfree(globalmem_devp);
 fail_malloc:
-    unregister_chrdev_region(dev_no, 1);
     return ret;
 }
 module_init(globalmem_init);
@@ -886,6 +1453,7 @@ static void __exit globalmem_exit(void)
 
     kobject_put(kobj_ref);
     sysfs_remove_file(kernel_kobj, &globalmem_attr.attr);
+    debugfs_remove_recursive(globalmem_debugfs);
 
     // Wakeup wait queue before exit driver.
     wait_queue_flag = 2;
@@ -903,6 +1471,8 @@ static void __exit globalmem_exit(void)
     class_destroy(dev_class);
     // Remove cdev from system.
     cdev_del(&globalmem_devp->cdev);
+    vfree(globalmem_devp->mem);
+    free_percpu(globalmem_devp->stats);
     kfree(globalmem_devp);
     // Free allocated device number.
     unregister_chrdev_region(dev_no, 1);
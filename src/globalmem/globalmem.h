@@ -0,0 +1,53 @@
+/*
+ * ioctl commands of globalmem device shared by kernel module and user space application.
+ */
+
+#ifndef GLOBALMEM_H
+#define GLOBALMEM_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define GLOBALMEM_MAGIC 'g'
+
+// An ioctl with write parameters (copy_from_user)
+#define MEM_CLEAR _IOW(GLOBALMEM_MAGIC, 0x01, int32_t *)
+// Register current task to receive signal SIGETX from kernel.
+#define REG_CURRENT_TASK _IOW(GLOBALMEM_MAGIC, 0x02, int32_t *)
+// Resize memory buffer (bytes, rounded up to page size), existing content is preserved.
+#define MEM_RESIZE _IOW(GLOBALMEM_MAGIC, 0x03, __u64)
+// Get current memory buffer size (bytes).
+#define MEM_GET_SIZE _IOR(GLOBALMEM_MAGIC, 0x04, __u64)
+
+// Operations of MEM_BATCH descriptor.
+#define MEM_OP_READ  0 // Copy len bytes at offset to user_ptr.
+#define MEM_OP_WRITE 1 // Copy len bytes from user_ptr to offset.
+#define MEM_OP_FILL  2 // Set len bytes at offset to low byte of value.
+#define MEM_OP_CAS   3 // If len (<= 8) bytes at offset equal expected, store value. Native byte order.
+
+// MEM_BATCH flags.
+#define MEM_BATCH_STOP_ON_ERROR 0x1 // Skip remaining ops (-ECANCELED) after the first failed op.
+
+#define MEM_BATCH_MAX 256 // Max number of ops per MEM_BATCH call.
+
+struct mem_batch_op {
+    __u32 op;
+    __s32 status;    // Output: bytes processed, or negative errno (-EAGAIN if CAS compare failed).
+    __u64 offset;
+    __u64 len;
+    __u64 user_ptr;  // User buffer of MEM_OP_READ / MEM_OP_WRITE.
+    __u64 value;     // Fill byte of MEM_OP_FILL, new value of MEM_OP_CAS.
+    __u64 expected;  // Compare value of MEM_OP_CAS, set to current value if compare failed.
+};
+
+struct mem_batch {
+    __u64 ops_ptr;   // Array of struct mem_batch_op, status fields are written back.
+    __u32 count;
+    __u32 flags;
+};
+
+// Execute all ops atomically under one exclusive lock hold, per-op result in status. Ops count in statistics
+// and tracepoints like read / write requests (MEM_OP_FILL / MEM_OP_CAS as writes).
+#define MEM_BATCH _IOWR(GLOBALMEM_MAGIC, 0x05, struct mem_batch)
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Tracepoints of globalmem device, enabled by /sys/kernel/tracing/events/globalmem.
+ * Disabled tracepoints cost only a static branch in read / write / poll paths.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM globalmem
+
+#if !defined(_GLOBALMEM_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _GLOBALMEM_TRACE_H
+
+#include <linux/tracepoint.h>
+
+// Read / write request: file offset, length, result, total latency and time waiting for buffer locks.
+DECLARE_EVENT_CLASS(globalmem_io,
+    TP_PROTO(loff_t offset, size_t len, ssize_t ret, u64 latency_ns, u64 lock_wait_ns),
+    TP_ARGS(offset, len, ret, latency_ns, lock_wait_ns),
+
+    TP_STRUCT__entry(
+        __field(loff_t, offset)
+        __field(size_t, len)
+        __field(ssize_t, ret)
+        __field(u64, latency_ns)
+        __field(u64, lock_wait_ns)
+    ),
+
+    TP_fast_assign(
+        __entry->offset = offset;
+        __entry->len = len;
+        __entry->ret = ret;
+        __entry->latency_ns = latency_ns;
+        __entry->lock_wait_ns = lock_wait_ns;
+    ),
+
+    TP_printk("offset=%lld len=%zu ret=%zd latency=%llu ns lock_wait=%llu ns",
+              __entry->offset, __entry->len, __entry->ret,
+              __entry->latency_ns, __entry->lock_wait_ns)
+);
+
+DEFINE_EVENT(globalmem_io, globalmem_read,
+    TP_PROTO(loff_t offset, size_t len, ssize_t ret, u64 latency_ns, u64 lock_wait_ns),
+    TP_ARGS(offset, len, ret, latency_ns, lock_wait_ns)
+);
+
+DEFINE_EVENT(globalmem_io, globalmem_write,
+    TP_PROTO(loff_t offset, size_t len, ssize_t ret, u64 latency_ns, u64 lock_wait_ns),
+    TP_ARGS(offset, len, ret, latency_ns, lock_wait_ns)
+);
+
+// Poll request: returned event mask.
+TRACE_EVENT(globalmem_poll,
+    TP_PROTO(unsigned int mask),
+    TP_ARGS(mask),
+
+    TP_STRUCT__entry(
+        __field(unsigned int, mask)
+    ),
+
+    TP_fast_assign(
+        __entry->mask = mask;
+    ),
+
+    TP_printk("mask=0x%x", __entry->mask)
+);
+
+#endif /* _GLOBALMEM_TRACE_H */
+
+// Trace header is not in include/trace/events, look for it in module directory.
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE globalmem_trace
+#include <trace/define_trace.h>
@@ -10,18 +10,33 @@
 #include <poll.h>
 #include <assert.h>
 #include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
+#include "globalmem.h"
 
 #define EPOLL_SIZE ( 256 )
 #define MAX_EVENTS (  20 )
 
+/***************** benchmark *******************/
+#define GLOBALMEM_SIZE 0x1000
+#define BENCH_LOOPS    100000
+#define BENCH_CHUNK    (1024 * 1024)       // I/O size per read / write call.
+#define BENCH_TOTAL    (256 * 1024 * 1024) // Bytes moved per buffer size.
+#define BENCH_THREADS  64                  // Max number of concurrent threads.
+#define BENCH_READ_LEN 64                  // Bytes per read in concurrent read benchmark.
+#define BENCH_SLOT_LEN 4096                // Bytes per thread private slot in concurrent write benchmark.
+#define BENCH_SECONDS  2
+#define BENCH_FIELDS   32                  // Fields updated per transaction in vectored I/O benchmark.
+#define BENCH_FIELD_LEN 8
+
 /***************** read / write device *******************/
 int8_t write_buf[1024];
 int8_t read_buf[1024];
-#define GLOBALMEM_MAGIC 'g'
-#define MEM_CLEAR _IOW(GLOBALMEM_MAGIC, 0x01, int32_t*)
 
 /***************** signal handler *******************/
-#define REG_CURRENT_TASK _IOW(GLOBALMEM_MAGIC, 0x02, int32_t*)
 #define SIGETX 44
 static int done = 0;
 int check = 0;
@@ -207,6 +222,350 @@ static void epoll_main(int fd)
     }
 }
 
+static double elapsed_sec(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void bench_report(const char *name, double sec)
+{
+    double mbytes = (double)GLOBALMEM_SIZE * BENCH_LOOPS / (1024 * 1024);
+
+    printf("%-6s: %d x %d bytes in %.3f s, %.1f MB/s, %.0f ns/op\n",
+           name, BENCH_LOOPS, GLOBALMEM_SIZE, sec, mbytes / sec, sec * 1e9 / BENCH_LOOPS);
+}
+
+/**
+ * Compare throughput to fetch the whole buffer via read() (copy_to_user) and via mmap() (direct access).
+ */
+static void bench_mmap_main(int fd)
+{
+    static unsigned char buf[GLOBALMEM_SIZE];
+    struct timespec start, end;
+    unsigned char *map;
+    unsigned long sum = 0;
+
+    map = (unsigned char *)mmap(NULL, GLOBALMEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_LOOPS; i++) {
+        if (pread(fd, buf, GLOBALMEM_SIZE, 0) != GLOBALMEM_SIZE) {
+            perror("pread");
+            break;
+        }
+        sum += buf[i % GLOBALMEM_SIZE];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    bench_report("read", elapsed_sec(&start, &end));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_LOOPS; i++) {
+        memcpy(buf, map, GLOBALMEM_SIZE);
+        sum += buf[i % GLOBALMEM_SIZE];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    bench_report("mmap", elapsed_sec(&start, &end));
+
+    // Print checksum so that compiler can't optimize out the copies.
+    printf("checksum = %lu\n", sum);
+
+    munmap(map, GLOBALMEM_SIZE);
+}
+
+/**
+ * Measure per-call latency of small pread() / pwrite() and print average, p50 and p99.
+ * Used by bench_trace.sh to compare printk logging with tracepoints.
+ */
+static void bench_latency_main(int fd)
+{
+    static uint64_t lat[BENCH_LOOPS];
+    char buf[BENCH_READ_LEN];
+    struct timespec start, end;
+
+    memset(buf, 0, sizeof(buf));
+    for (int dir = 0; dir < 2; dir++) {
+        double sum = 0;
+
+        for (int i = 0; i < BENCH_LOOPS; i++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            ssize_t ret = dir ? pread(fd, buf, sizeof(buf), 0) : pwrite(fd, buf, sizeof(buf), 0);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            if (ret < 0) {
+                perror(dir ? "pread" : "pwrite");
+                return;
+            }
+            lat[i] = (end.tv_sec - start.tv_sec) * 1000000000ULL + (end.tv_nsec - start.tv_nsec);
+            sum += lat[i];
+        }
+
+        std::sort(lat, lat + BENCH_LOOPS);
+        printf("%-5s latency: avg %.0f ns, p50 %lu ns, p99 %lu ns\n", dir ? "read" : "write",
+               sum / BENCH_LOOPS, (unsigned long)lat[BENCH_LOOPS / 2], (unsigned long)lat[BENCH_LOOPS * 99 / 100]);
+    }
+}
+
+/**
+ * Update BENCH_FIELDS small fields by one pwrite() per field vs. a single pwritev() call.
+ */
+static void bench_vector_main(int fd)
+{
+    static uint64_t fields[BENCH_FIELDS];
+    struct iovec iov[BENCH_FIELDS];
+    struct timespec start, end;
+    int loops = BENCH_LOOPS / 10;
+
+    for (int i = 0; i < BENCH_FIELDS; i++) {
+        fields[i] = i;
+        iov[i].iov_base = &fields[i];
+        iov[i].iov_len = BENCH_FIELD_LEN;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < loops; n++) {
+        for (int i = 0; i < BENCH_FIELDS; i++) {
+            if (pwrite(fd, &fields[i], BENCH_FIELD_LEN, i * BENCH_FIELD_LEN) != BENCH_FIELD_LEN) {
+                perror("pwrite");
+                return;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("pwrite  x %d: %.0f ns per update\n", BENCH_FIELDS, elapsed_sec(&start, &end) * 1e9 / loops);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < loops; n++) {
+        // Segments are written back to back from offset 0.
+        if (pwritev(fd, iov, BENCH_FIELDS, 0) != BENCH_FIELDS * BENCH_FIELD_LEN) {
+            perror("pwritev");
+            return;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("pwritev x  1: %.0f ns per update\n", elapsed_sec(&start, &end) * 1e9 / loops);
+}
+
+/**
+ * Control-plane transaction: read-modify-write BENCH_FIELDS fields by pread() / pwrite() vs. one MEM_BATCH
+ * with a compare-and-swap per field.
+ */
+static void bench_batch_main(int fd)
+{
+    static struct mem_batch_op ops[BENCH_FIELDS];
+    struct mem_batch batch;
+    struct timespec start, end;
+    uint64_t value;
+    int loops = BENCH_LOOPS / 10;
+
+    // Start from known state so that every CAS succeeds.
+    ioctl(fd, MEM_CLEAR, (int *) 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < loops; n++) {
+        for (int i = 0; i < BENCH_FIELDS; i++) {
+            if (pread(fd, &value, BENCH_FIELD_LEN, i * BENCH_FIELD_LEN) != BENCH_FIELD_LEN) {
+                perror("pread");
+                return;
+            }
+            value++;
+            if (pwrite(fd, &value, BENCH_FIELD_LEN, i * BENCH_FIELD_LEN) != BENCH_FIELD_LEN) {
+                perror("pwrite");
+                return;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("pread / pwrite x %d: %.0f ns per transaction\n", 2 * BENCH_FIELDS, elapsed_sec(&start, &end) * 1e9 / loops);
+
+    memset(ops, 0, sizeof(ops));
+    for (int i = 0; i < BENCH_FIELDS; i++) {
+        ops[i].op = MEM_OP_CAS;
+        ops[i].offset = i * BENCH_FIELD_LEN;
+        ops[i].len = BENCH_FIELD_LEN;
+        ops[i].expected = loops;
+        ops[i].value = loops + 1;
+    }
+    batch.ops_ptr = (uint64_t)(uintptr_t)ops;
+    batch.count = BENCH_FIELDS;
+    batch.flags = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int n = 0; n < loops; n++) {
+        if (ioctl(fd, MEM_BATCH, &batch) < 0) {
+            perror("MEM_BATCH");
+            return;
+        }
+        for (int i = 0; i < BENCH_FIELDS; i++) {
+            ops[i].expected++;
+            ops[i].value++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("MEM_BATCH        x  1: %.0f ns per transaction, last CAS status %d\n",
+           elapsed_sec(&start, &end) * 1e9 / loops, ops[BENCH_FIELDS - 1].status);
+}
+
+/**
+ * Write and read back the whole buffer in BENCH_CHUNK pieces for several buffer sizes.
+ */
+static void bench_size_main(int fd)
+{
+    static const uint64_t sizes[] = {
+        4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 256 * 1024 * 1024
+    };
+    struct timespec start, end;
+    uint64_t orig_size, size;
+    char *buf;
+
+    if (ioctl(fd, MEM_GET_SIZE, &orig_size) < 0) {
+        perror("MEM_GET_SIZE");
+        return;
+    }
+
+    buf = (char *)malloc(BENCH_CHUNK);
+    if (buf == NULL) {
+        return;
+    }
+    memset(buf, 0x5a, BENCH_CHUNK);
+
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size = sizes[i];
+        if (ioctl(fd, MEM_RESIZE, &size) < 0) {
+            perror("MEM_RESIZE");
+            break;
+        }
+
+        for (int dir = 0; dir < 2; dir++) {
+            uint64_t moved = 0;
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            while (moved < BENCH_TOTAL) {
+                for (uint64_t off = 0; off < size; off += BENCH_CHUNK) {
+                    size_t len = (size - off < BENCH_CHUNK) ? size - off : BENCH_CHUNK;
+                    ssize_t ret = dir ? pread(fd, buf, len, off) : pwrite(fd, buf, len, off);
+                    if (ret <= 0) {
+                        perror(dir ? "pread" : "pwrite");
+                        goto out;
+                    }
+                    moved += ret;
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            printf("size %10lu bytes: %-5s %8.1f MB/s\n", (unsigned long)size, dir ? "read" : "write",
+                   moved / (1024.0 * 1024.0) / elapsed_sec(&start, &end));
+        }
+    }
+
+out:
+    ioctl(fd, MEM_RESIZE, &orig_size);
+    free(buf);
+}
+
+struct bench_thread {
+    pthread_t tid;
+    int fd;
+    unsigned int seed; // Random seed / thread index.
+    unsigned long ops;
+};
+
+static volatile int bench_stop = 0;
+
+static void *bench_read_thread(void *arg)
+{
+    struct bench_thread *t = (struct bench_thread *)arg;
+    char buf[BENCH_READ_LEN];
+    off_t size = lseek(t->fd, 0, SEEK_END);
+
+    while (!bench_stop) {
+        off_t off = rand_r(&t->seed) % (size - BENCH_READ_LEN + 1);
+        if (pread(t->fd, buf, BENCH_READ_LEN, off) != BENCH_READ_LEN) {
+            perror("pread");
+            break;
+        }
+        t->ops++;
+    }
+    return NULL;
+}
+
+static void *bench_write_thread(void *arg)
+{
+    struct bench_thread *t = (struct bench_thread *)arg;
+    char buf[BENCH_SLOT_LEN];
+    // Each producer owns a separate slot.
+    off_t off = (off_t)t->seed * BENCH_SLOT_LEN;
+
+    memset(buf, t->seed, sizeof(buf));
+    while (!bench_stop) {
+        if (pwrite(t->fd, buf, BENCH_SLOT_LEN, off) != BENCH_SLOT_LEN) {
+            perror("pwrite");
+            break;
+        }
+        t->ops++;
+    }
+    return NULL;
+}
+
+/**
+ * Run thread function on 1..BENCH_THREADS threads and report aggregated ops/s vs. thread count.
+ * Switch concurrency mode by /sys/module/globalmem/parameters/globalmem_concurrent.
+ */
+static void bench_thread_main(void *(*fn)(void *), const char *name)
+{
+    static struct bench_thread threads[BENCH_THREADS];
+
+    for (int n = 1; n <= BENCH_THREADS; n *= 2) {
+        unsigned long total = 0;
+
+        bench_stop = 0;
+        for (int i = 0; i < n; i++) {
+            threads[i].fd = open("/dev/globalmem", O_RDWR);
+            threads[i].seed = i;
+            threads[i].ops = 0;
+            if (threads[i].fd < 0 || pthread_create(&threads[i].tid, NULL, fn, &threads[i])) {
+                perror("Cannot start benchmark thread");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        sleep(BENCH_SECONDS);
+        bench_stop = 1;
+
+        for (int i = 0; i < n; i++) {
+            pthread_join(threads[i].tid, NULL);
+            close(threads[i].fd);
+            total += threads[i].ops;
+        }
+        printf("%2d threads: %10.0f %s ops/s\n", n, (double)total / BENCH_SECONDS, name);
+    }
+}
+
+/**
+ * Concurrent writers to disjoint slots, buffer is grown to hold one slot per thread.
+ */
+static void bench_write_main(int fd)
+{
+    uint64_t orig_size, size = (uint64_t)BENCH_THREADS * BENCH_SLOT_LEN;
+
+    if (ioctl(fd, MEM_GET_SIZE, &orig_size) < 0) {
+        perror("MEM_GET_SIZE");
+        return;
+    }
+    if (orig_size < size && ioctl(fd, MEM_RESIZE, &size) < 0) {
+        perror("MEM_RESIZE");
+        return;
+    }
+
+    bench_thread_main(bench_write_thread, "write");
+
+    if (orig_size < size) {
+        ioctl(fd, MEM_RESIZE, &orig_size);
+    }
+}
+
 int main()
 {
     int fd;
@@ -231,6 +590,13 @@ int main()
         printf("        6. select main                  \n");
         printf("        7. epoll main                   \n");
         printf("        8. Exit                         \n");
+        printf("        9. Benchmark mmap vs read       \n");
+        printf("        a. Benchmark buffer sizes       \n");
+        printf("        b. Benchmark concurrent read    \n");
+        printf("        c. Benchmark concurrent write   \n");
+        printf("        d. Benchmark syscall latency    \n");
+        printf("        e. Benchmark vectored write     \n");
+        printf("        f. Benchmark MEM_BATCH          \n");
         printf("****************************************\n");
         scanf(" %c", &option);
         printf("Your Option = %c\n", option);
@@ -271,6 +637,27 @@ int main()
             close(fd);
             exit(1);
             break;
+        case '9':
+            bench_mmap_main(fd);
+            break;
+        case 'a':
+            bench_size_main(fd);
+            break;
+        case 'b':
+            bench_thread_main(bench_read_thread, "read");
+            break;
+        case 'c':
+            bench_write_main(fd);
+            break;
+        case 'd':
+            bench_latency_main(fd);
+            break;
+        case 'e':
+            bench_vector_main(fd);
+            break;
+        case 'f':
+            bench_batch_main(fd);
+            break;
         default:
             printf("Enter Valid option = %c\n", option);
             break;